@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <unistd.h>
+
+#include<readline/readline.h>
+
+#include "protocol.h"
+
+/* 
+ * PURPOSE: Command line client for matlab --serve. With a command after the
+ * 			socket path it runs just that command, otherwise it reads commands
+ * 			from the user until exit like matlab itself.
+ * 
+ * INPUTS: 
+ *	      argc : number of arguments
+ * 		  argv : matlab_client <socket_path> [command ...]
+ * 
+ * RETURN: 0 if every command got a reply, -1 otherwise.
+ **/
+int main (int argc, char **argv) {
+
+	if (argc < 2) {
+		printf("usage: %s <socket_path> [command ...]\n", argv[0]);
+		return -1;
+	}
+	int fd = connect_to_server(argv[1]);
+	if (fd < 0) {
+		return -1;
+	}
+
+	if (argc > 2) {
+		char request[MAX_REQUEST_LEN];
+		size_t len = 0;
+		for (int i = 2; i < argc; ++i) {
+			int n = snprintf(&request[len], sizeof(request) - len, "%s%s", argv[i],
+					i + 1 < argc ? " " : "\n");
+			if (n < 0 || len + n >= sizeof(request)) {
+				printf("Command is too long\n");
+				close(fd);
+				return -1;
+			}
+			len += n;
+		}
+		bool ok = send_all(fd, request, len) && read_response(fd, stdout);
+		close(fd);
+		return ok ? 0 : -1;
+	}
+
+	char *line = readline("> ");
+	while (line && strncmp(line,"exit", strlen("exit")  + 1) != 0) {
+		size_t len = strlen(line);
+		if (len + 1 >= MAX_REQUEST_LEN) {
+			printf("Command is too long\n");
+		}
+		else {
+			line[len] = '\n';
+			if (!send_all(fd, line, len + 1) || !read_response(fd, stdout)) {
+				printf("\nLost connection to the server\n");
+				free(line);
+				close(fd);
+				return -1;
+			}
+		}
+		free(line);
+		line = readline("> ");
+	}
+	free(line);
+	close(fd);
+	return 0;
+}
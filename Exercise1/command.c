@@ -4,6 +4,7 @@
 #include <stdbool.h>
 
 #include "command.h"
+#include "matrix.h"
 
 #define MAX_CMD_COUNT 50
 #define MAX_CMD_LEN 25
@@ -37,12 +38,13 @@ bool parse_user_input (const char* input, Commands_t** cmd) {
 	char *token;
 	token = strtok(string, " \n");
 	for (; token != NULL && i < MAX_CMD_COUNT; ++i) {
-		(*cmd)->cmds[i] = calloc(MAX_CMD_LEN,sizeof(char));
+		const size_t len = strlen(token);
+		(*cmd)->cmds[i] = calloc(len + 1,sizeof(char));
 		if (!(*cmd)->cmds[i]) {
 			perror("Allocation Error\n");
 			return false;
 		}	
-		strncpy((*cmd)->cmds[i],token, strlen(token) + 1);
+		memcpy((*cmd)->cmds[i],token, len + 1);
 		(*cmd)->num_cmds++;
 		token = strtok(NULL, " \n");
 	}
@@ -50,6 +52,75 @@ bool parse_user_input (const char* input, Commands_t** cmd) {
 	return true;
 }
 
+/* 
+ * PURPOSE: Breaks a line of commands separated by ';' into one Commands_t per
+ * 			command. Empty commands, as in "a;;b" or a trailing ';', are skipped.
+ * INPUTS: 
+ * 		   input : string from user of one or more commands
+ * 		   cmds : receives the array of parsed commands
+ * 		   num_cmds : receives the number of commands in the array
+ * RETURN: True if every command was parsed. On failure nothing is returned.
+ **/
+bool parse_command_line (const char* input, Commands_t*** cmds, unsigned int* num_cmds) {
+
+	if (!input || !cmds || !num_cmds) {
+		perror("Passed NULL pointer parse_command_line\n");
+		return false;
+	}
+	*cmds = NULL;
+	*num_cmds = 0;
+	unsigned int capacity = 1;
+	for (const char* p = input; *p; ++p) {
+		capacity += *p == ';';
+	}
+	*cmds = calloc(capacity, sizeof(Commands_t*));
+	char* string = strdup(input);
+	if (!*cmds || !string) {
+		perror("Allocation Error\n");
+		free(*cmds);
+		free(string);
+		*cmds = NULL;
+		return false;
+	}
+
+	char* save = NULL;
+	for (char* part = strtok_r(string, ";", &save); part; part = strtok_r(NULL, ";", &save)) {
+		Commands_t* cmd = NULL;
+		if (!parse_user_input(part, &cmd)) {
+			destroy_command_line(cmds, *num_cmds);
+			*num_cmds = 0;
+			free(string);
+			return false;
+		}
+		if (cmd->num_cmds == 0) {
+			destroy_commands(&cmd);
+			continue;
+		}
+		(*cmds)[(*num_cmds)++] = cmd;
+	}
+	free(string);
+	return true;
+}
+
+/* 
+ * PURPOSE: Unallocate every command returned by parse_command_line
+ * INPUTS: 
+ * 		   cmds : the array of commands, set to NULL
+ * 		   num_cmds : the number of commands in the array
+ * RETURN: void
+ **/
+void destroy_command_line (Commands_t*** cmds, unsigned int num_cmds) {
+
+	if (!cmds || !*cmds) {
+		return;
+	}
+	for (unsigned int i = 0; i < num_cmds; ++i) {
+		destroy_commands(&(*cmds)[i]);
+	}
+	free(*cmds);
+	*cmds = NULL;
+}
+
 	/* 
 	 * PURPOSE: Unallocate memory dedicated to commands.
 	 * INPUTS: 
@@ -71,3 +142,99 @@ void destroy_commands(Commands_t** cmd) {
 	*cmd = NULL;
 }
 
+/* 
+ * PURPOSE: Works out which matrices a command reads and writes from its name and
+ * 		    arguments, without running it. Used to decide which matrices must be
+ * 		    locked, or which commands may run at the same time.
+ * INPUTS: 
+ * 		   cmd : parsed command
+ * 		   access : filled with the names the command reads and writes
+ * RETURN: True if access was filled. False if cmd or access is null.
+ **/
+bool command_access (const Commands_t* cmd, Command_Access_t* access) {
+
+	if (!cmd || !access) {
+		printf("\nERROR:Command or access is NULL\n");
+		return false;
+	}
+	memset(access, 0, sizeof(Command_Access_t));
+	if (cmd->num_cmds == 0) {
+		return true;
+	}
+
+	const char* name = cmd->cmds[0];
+	const unsigned int n = cmd->num_cmds;
+	Elementwise_Op_t op;
+	bool scalar = false;
+	if (elementwise_command(name, n, &op, &scalar)) {
+		access->reads[access->num_reads++] = cmd->cmds[1];
+		if (!scalar) {
+			access->reads[access->num_reads++] = cmd->cmds[2];
+		}
+		access->writes[access->num_writes++] = cmd->cmds[n - 1];
+		access->registers = true;
+	}
+	else if ((strcmp(name, "display") == 0 || strcmp(name, "write") == 0
+		|| strcmp(name, "sum") == 0) && n == 2) {
+		access->reads[access->num_reads++] = cmd->cmds[1];
+	}
+	else if ((strcmp(name, "hist") == 0 && (n == 2 || n == 3)) || (strcmp(name, "distinct") == 0 && n == 2)) {
+		access->reads[access->num_reads++] = cmd->cmds[1];
+	}
+	else if ((strcmp(name, "median") == 0 && n == 2) || (strcmp(name, "percentile") == 0 && n == 3)) {
+		access->reads[access->num_reads++] = cmd->cmds[1];
+	}
+	else if (strcmp(name, "sort") == 0 && (n == 2 || n == 3)) {
+		access->writes[access->num_writes++] = cmd->cmds[1];
+	}
+	else if (strcmp(name, "topk") == 0 && n == 4) {
+		access->reads[access->num_reads++] = cmd->cmds[1];
+		access->writes[access->num_writes++] = cmd->cmds[3];
+		access->registers = true;
+	}
+	else if (strcmp(name, "hist") == 0 && n == 4) {
+		access->reads[access->num_reads++] = cmd->cmds[1];
+		access->writes[access->num_writes++] = cmd->cmds[3];
+		access->registers = true;
+	}
+	else if (strcmp(name, "equal") == 0 && n == 3) {
+		access->reads[access->num_reads++] = cmd->cmds[1];
+		access->reads[access->num_reads++] = cmd->cmds[2];
+	}
+	else if ((strcmp(name, "duplicate") == 0 || strcmp(name, "transpose") == 0
+		|| strcmp(name, "rowsum") == 0 || strcmp(name, "colsum") == 0) && n == 3) {
+		access->reads[access->num_reads++] = cmd->cmds[1];
+		access->writes[access->num_writes++] = cmd->cmds[2];
+		access->registers = true;
+	}
+	else if (strcmp(name, "conv") == 0 && (n == 4 || n == 5)) {
+		access->reads[access->num_reads++] = cmd->cmds[1];
+		access->reads[access->num_reads++] = cmd->cmds[2];
+		access->writes[access->num_writes++] = cmd->cmds[3];
+		access->registers = true;
+	}
+	else if ((strcmp(name, "shift") == 0 || strcmp(name, "random") == 0) && n == 4) {
+		access->writes[access->num_writes++] = cmd->cmds[1];
+	}
+	else if (strcmp(name, "transpose") == 0 && n == 2) {
+		access->writes[access->num_writes++] = cmd->cmds[1];
+	}
+	else if (strcmp(name, "view") == 0 && n == 7) {
+		/* the parent is written, it keeps count of its views */
+		access->writes[access->num_writes++] = cmd->cmds[2];
+		access->writes[access->num_writes++] = cmd->cmds[1];
+		access->registers = true;
+	}
+	else if (strcmp(name, "create") == 0 && n == 4) {
+		access->writes[access->num_writes++] = cmd->cmds[1];
+		access->registers = true;
+	}
+	else if (strcmp(name, "save") == 0 || strcmp(name, "mem") == 0) {
+		access->unknown = true;
+	}
+	else if (strcmp(name, "read") == 0 || strcmp(name, "load") == 0) {
+		access->registers = true;
+		access->unknown = true;
+	}
+	return true;
+}
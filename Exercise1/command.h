@@ -6,7 +6,28 @@ typedef struct {
 	char** cmds;
 }Commands_t;
 
+#define MAX_CMD_ACCESS 4
+
+/*
+ * The matrices a command touches, by name. reads are only looked at,
+ * writes are modified in place or created. A command that registers
+ * adds a matrix to the array, which may evict any other matrix. A
+ * command whose matrices cannot be known from its arguments (read)
+ * is marked unknown and must be treated as touching everything.
+ */
+typedef struct {
+	unsigned int num_reads;
+	const char* reads[MAX_CMD_ACCESS];
+	unsigned int num_writes;
+	const char* writes[MAX_CMD_ACCESS];
+	bool registers;
+	bool unknown;
+}Command_Access_t;
+
 bool parse_user_input (const char* input, Commands_t** cmd);
 void destroy_commands(Commands_t** cmd);
+bool parse_command_line (const char* input, Commands_t*** cmds, unsigned int* num_cmds);
+void destroy_command_line (Commands_t*** cmds, unsigned int num_cmds);
+bool command_access (const Commands_t* cmd, Command_Access_t* access);
 
 #endif
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <unistd.h>
+
+#include "protocol.h"
+
+typedef struct {
+	const char* socket_path;
+	const char* request;
+	size_t request_len;
+	unsigned int num_requests;
+	double* latencies;
+	unsigned int completed;
+}Load_Client_t;
+
+static double now_seconds (void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compare_doubles (const void* a, const void* b) {
+	double x = *(const double*) a;
+	double y = *(const double*) b;
+	return (x > y) - (x < y);
+}
+
+/* 
+ * PURPOSE: One simulated client. Sends its requests back to back on its own
+ * 			connection, recording how long each reply took.
+ * INPUTS: 
+ * 		   arg : the Load_Client_t to run
+ * RETURN: NULL
+ **/
+static void* client_main (void* arg) {
+	Load_Client_t* lc = arg;
+	int fd = connect_to_server(lc->socket_path);
+	if (fd < 0) {
+		return NULL;
+	}
+	for (unsigned int i = 0; i < lc->num_requests; ++i) {
+		double start = now_seconds();
+		if (!send_all(fd, lc->request, lc->request_len) || !read_response(fd, NULL)) {
+			printf("Client lost its connection after %u requests\n", i);
+			break;
+		}
+		lc->latencies[lc->completed++] = now_seconds() - start;
+	}
+	close(fd);
+	return NULL;
+}
+
+/* 
+ * PURPOSE: Load generator for matlab --serve. Runs a number of concurrent clients
+ * 			that each send the same command repeatedly, then reports throughput
+ * 			and the latency distribution over every request.
+ * 
+ * INPUTS: 
+ *	      argc : number of arguments
+ * 		  argv : matlab_load <socket_path> <clients> <requests_per_client> <command ...>
+ * 
+ * RETURN: 0 if the load ran, -1 on bad arguments or allocation failure.
+ **/
+int main (int argc, char **argv) {
+
+	if (argc < 5) {
+		printf("usage: %s <socket_path> <clients> <requests_per_client> <command ...>\n", argv[0]);
+		return -1;
+	}
+	const unsigned int num_clients = atoi(argv[2]);
+	const unsigned int num_requests = atoi(argv[3]);
+	if (num_clients == 0 || num_requests == 0) {
+		printf("clients and requests_per_client must be positive\n");
+		return -1;
+	}
+
+	char request[MAX_REQUEST_LEN];
+	size_t len = 0;
+	for (int i = 4; i < argc; ++i) {
+		int n = snprintf(&request[len], sizeof(request) - len, "%s%s", argv[i],
+				i + 1 < argc ? " " : "\n");
+		if (n < 0 || len + n >= sizeof(request)) {
+			printf("Command is too long\n");
+			return -1;
+		}
+		len += n;
+	}
+
+	Load_Client_t* clients = calloc(num_clients, sizeof(Load_Client_t));
+	pthread_t* tids = calloc(num_clients, sizeof(pthread_t));
+	double* latencies = calloc((size_t) num_clients * num_requests, sizeof(double));
+	if (!clients || !tids || !latencies) {
+		perror("Failed to allocate clients\n");
+		free(clients);
+		free(tids);
+		free(latencies);
+		return -1;
+	}
+
+	double start = now_seconds();
+	unsigned int started = 0;
+	for (; started < num_clients; ++started) {
+		clients[started].socket_path = argv[1];
+		clients[started].request = request;
+		clients[started].request_len = len;
+		clients[started].num_requests = num_requests;
+		clients[started].latencies = &latencies[(size_t) started * num_requests];
+		if (pthread_create(&tids[started], NULL, client_main, &clients[started])) {
+			perror("Failed to start client thread\n");
+			break;
+		}
+	}
+	for (unsigned int i = 0; i < started; ++i) {
+		pthread_join(tids[i], NULL);
+	}
+	double elapsed = now_seconds() - start;
+
+	/* pack the latencies of every client together and rank them */
+	size_t total = 0;
+	for (unsigned int i = 0; i < started; ++i) {
+		memmove(&latencies[total], clients[i].latencies, clients[i].completed * sizeof(double));
+		total += clients[i].completed;
+	}
+	qsort(latencies, total, sizeof(double), compare_doubles);
+
+	printf("%zu requests from %u clients in %.3f s\n", total, started, elapsed);
+	if (total > 0) {
+		printf("throughput: %.0f requests/s\n", total / elapsed);
+		printf("latency ms: p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f\n",
+				latencies[total / 2] * 1e3,
+				latencies[total * 90 / 100] * 1e3,
+				latencies[total * 99 / 100] * 1e3,
+				latencies[total * 999 / 1000] * 1e3,
+				latencies[total - 1] * 1e3);
+	}
+
+	free(clients);
+	free(tids);
+	free(latencies);
+	return 0;
+}
@@ -5,18 +5,30 @@
 #include <math.h>
 #include <stdbool.h>
 #include <time.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
 
 #include<readline/readline.h>
 
 #include "command.h"
 #include "matrix.h"
+#include "scheduler.h"
+#include "server.h"
+#include "workspace.h"
 
-void run_commands (Commands_t* cmd, Matrix_t** mats, unsigned int num_mats);
-unsigned int find_matrix_given_name (Matrix_t** mats, unsigned int num_mats, 
+void run_commands (Commands_t* cmd, Matrix_t** mats, unsigned int num_mats, FILE* out);
+void run_elementwise (Commands_t* cmd, Matrix_t** mats, unsigned int num_mats,
+			Elementwise_Op_t op, bool scalar, FILE* out);
+void run_histogram (Commands_t* cmd, Matrix_t** mats, unsigned int num_mats, FILE* out);
+bool parse_scalar (const char* text, unsigned int* value);
+bool parse_size (const char* text, size_t* value);
+unsigned int find_matrix_given_name (FILE* out, Matrix_t** mats, unsigned int num_mats, 
 			const char* target);
 
 //TODO complete the defintion of this function. 
 void destroy_remaining_heap_allocations(Matrix_t **mats, unsigned int num_mats);
+bool parse_byte_size (const char* text, size_t* bytes);
 
 /* 
  * PURPOSE: The main function that ties everything together and processes user input commands and calls
@@ -24,7 +36,10 @@ void destroy_remaining_heap_allocations(Matrix_t **mats, unsigned int num_mats);
  * 
  * INPUTS: 
  *	      argc : is the number of commands entered when starting the program matlab
- * 		  argv : list of commands used to start the program
+ * 		  argv : list of commands used to start the program, "--serve <socket_path>"
+ * 		         serves the matrices over a unix socket instead of the command line,
+ * 		         "--workspace <file>" loads the matrices from file and saves them back on exit,
+ * 		         "--mem-budget <size>" spills matrices to disk beyond size bytes of data
  * 
  * RETURN: If no errors during execution output = 0 if errors exist some other error value will be returned.
  *
@@ -34,64 +49,113 @@ int main (int argc, char **argv) {
 	
 	srand(time(NULL));  		
 	char *line = NULL; 
-	Commands_t* cmd;
+	Commands_t** cmds = NULL;
+	unsigned int num_cmds = 0;
 	Matrix_t *mats[10];
 
 	memset(&mats,0, sizeof(Matrix_t*) * 10); //IMPORTANT C FUNCTION TO LEARN
-	Matrix_t *temp = NULL;
-	
-	//Check if creation of 'temp_mat' was successful. Notify
-	if(!create_matrix(&temp,"temp_mat", 5, 5)) {
-		perror("The creation of temp_mat failed\n");
-		return -1;
-	}else{
-		printf("\nMatrix %s was successfully created!\n",temp->name);
-	}
-	
-	//Check if addtion of temp_mat to the array was successful.
-	unsigned int pos = add_matrix_to_array(mats,temp, 10);
-	if(pos > 10){
-		perror("Addition to array of matrices failed\n");
-		return -1;
+
+	const char* serve_path = NULL;
+	const char* workspace = NULL;
+	for (int i = 1; i < argc; ++i) {
+		if (strncmp(argv[i], "--serve", strlen("--serve") + 1) == 0 && i + 1 < argc) {
+			serve_path = argv[++i];
+		}
+		else if (strncmp(argv[i], "--workspace", strlen("--workspace") + 1) == 0 && i + 1 < argc) {
+			workspace = argv[++i];
+		}
+		else if (strncmp(argv[i], "--mem-budget", strlen("--mem-budget") + 1) == 0 && i + 1 < argc) {
+			size_t budget = 0;
+			if (!parse_byte_size(argv[++i], &budget)) {
+				printf("Bad memory budget %s, expected a size such as 512M or 8G\n", argv[i]);
+				return -1;
+			}
+			set_memory_budget(budget);
+		}
+		else {
+			printf("usage: %s [--serve <socket_path>] [--workspace <file>] [--mem-budget <size>]\n", argv[0]);
+			return -1;
+		}
 	}
-	else{
-		printf("\n%s was added to the array of matrices successfully!",temp->name);
+
+	//Resume from the workspace when there is one, otherwise start from temp_mat.
+	if (workspace && access(workspace, F_OK) == 0) {
+		if (!load_workspace(stdout, workspace, mats, 10)) {
+			perror("Loading the workspace failed\n");
+			return -1;
+		}
+		printf("\nWorkspace %s was loaded\n", workspace);
 	}
+	else if (!workspace) {
+		Matrix_t *temp = NULL;
+	
+		//Check if creation of 'temp_mat' was successful. Notify
+		if(!create_matrix(stdout, &temp,"temp_mat", 5, 5)) {
+			perror("The creation of temp_mat failed\n");
+			return -1;
+		}else{
+			printf("\nMatrix %s was successfully created!\n",temp->name);
+		}
+	
+		//Check if addtion of temp_mat to the array was successful.
+		unsigned int pos = add_matrix_to_array(stdout, mats,temp, 10);
+		if(pos > 10){
+			perror("Addition to array of matrices failed\n");
+			return -1;
+		}
+		else{
+			printf("\n%s was added to the array of matrices successfully!",temp->name);
+		}
 
-	int mat_idx = find_matrix_given_name(mats,10,"temp_mat");
+		int mat_idx = find_matrix_given_name(stdout, mats,10,"temp_mat");
 
-	if (mat_idx < 0) {
-		perror("PROGRAM FAILED TO INIT\n");
-		return -1;
-	}
+		if (mat_idx < 0) {
+			perror("PROGRAM FAILED TO INIT\n");
+			return -1;
+		}
 	
-	random_matrix(mats[mat_idx], 10, 15);
+		random_matrix(stdout, mats[mat_idx], 10, 15);
 	
-	//Check if matrix written to file.
-	if(!write_matrix("temp_mat", mats[mat_idx])){ 
-		perror("Writing temp_mat to a file failed\n");
-		return -1;
-	}else{
-		printf("\ntemp_mat was successfully written to a file!\n");
+		//Check if matrix written to file.
+		if(!write_matrix(stdout, "temp_mat", mats[mat_idx])){ 
+			perror("Writing temp_mat to a file failed\n");
+			return -1;
+		}else{
+			printf("\ntemp_mat was successfully written to a file!\n");
+		}
 	}
-	
+
+	//Serve the matrices to local clients instead of reading commands.
+	if (serve_path) {
+		bool served = serve(serve_path, mats, 10);
+		if (workspace && !save_workspace(stdout, workspace, mats, 10)) {
+			served = false;
+		}
+		destroy_remaining_heap_allocations(mats,10);
+		return served ? 0 : -1;
+	}
+
 	line = readline("> ");
 	while(strncmp(line,"exit", strlen("exit")  + 1) != 0) {
 		
-		if (!parse_user_input(line,&cmd)) {
+		//A line may hold several commands separated by ';', independent ones run together.
+		if (!parse_command_line(line,&cmds,&num_cmds)) {
 			printf("\nERROR:Failed at parsing command\n");
 		}
-		
-		if (cmd->num_cmds > 1) {	
-			run_commands(cmd,mats,10);
+		else if (num_cmds > 0) {	
+			run_command_batch(cmds,num_cmds,mats,10,stdout);
 		}
 		if (line) {
 			free(line);
 		}
-		destroy_commands(&cmd);
+		destroy_command_line(&cmds,num_cmds);
 		line = readline("> ");
 	}
 	free(line);
+	//Keep the matrices for the next run.
+	if (workspace && !save_workspace(stdout, workspace, mats, 10)) {
+		perror("Saving the workspace failed\n");
+	}
 	destroy_remaining_heap_allocations(mats,10);
 	return 0;	
 }
@@ -103,113 +167,96 @@ int main (int argc, char **argv) {
  * 		   cmd : list of commands
  * 	       mats : list of matrices
  * 	       num_mats : is the number of matrices in the list.
+ * 	       out : stream the command's results are printed to.
  * RETURN: void
  **/
  
-void run_commands (Commands_t* cmd, Matrix_t** mats, unsigned int num_mats) {
-	//Check if cmd or first matrix (mat[0])is NULL
+void run_commands (Commands_t* cmd, Matrix_t** mats, unsigned int num_mats, FILE* out) {
+	//Check if cmd or the array of matrices is NULL
 	if(!cmd){
-		perror("\nCommand list is empty\n");
+		fprintf(out,"\nCommand list is empty\n");
 		return;
 	}
-	if(!(*mats)){
-		perror("\nThere are no matrices in the array");
+	if(!mats){
+		fprintf(out,"\nThere is no array of matrices\n");
+		return;
 	}
+	//Keep the matrices this command looks up in memory until it finishes.
+	unpin_matrices();
+	Elementwise_Op_t op;
+	bool scalar = false;
 
 	/*Parsing and calling of commands*/
 	if (strncmp(cmd->cmds[0],"display",strlen("display") + 1) == 0
 		&& cmd->num_cmds == 2) {
 			/*find the requested matrix*/
-			int idx = find_matrix_given_name(mats,num_mats,cmd->cmds[1]);
+			int idx = find_matrix_given_name(out, mats,num_mats,cmd->cmds[1]);
 			if (idx >= 0) {
-				display_matrix (mats[idx]);
+				fdisplay_matrix (out, mats[idx]);
 			}
 			else {
-				printf("Matrix (%s) doesn't exist\n", cmd->cmds[1]);
+				fprintf(out,"Matrix (%s) doesn't exist\n", cmd->cmds[1]);
 				return;
 			}
 	}
-	else if (strncmp(cmd->cmds[0],"add",strlen("add") + 1) == 0
-		&& cmd->num_cmds == 4) {
-			int mat1_idx = find_matrix_given_name(mats,num_mats,cmd->cmds[1]);
-			int mat2_idx = find_matrix_given_name(mats,num_mats,cmd->cmds[2]);
-			if (mat1_idx >= 0 && mat2_idx >= 0) {
-				Matrix_t* c = NULL;
-				if( !create_matrix (&c,cmd->cmds[3], mats[mat1_idx]->rows, 
-						mats[mat1_idx]->cols)) {
-					printf("Failure to create the result Matrix (%s)\n", cmd->cmds[3]);
-					return;
-				}
-				
-				//Check if add mat to array failed.
-				int pos = add_matrix_to_array(mats,c, num_mats);
-				printf("\npos = %d\n",pos);
-				if(pos > num_mats){
-					perror("matrix failed to be added to the array");
-					return;
-				}
-
-
-				if (! add_matrices(mats[mat1_idx], mats[mat2_idx],c) ) {
-					printf("Failure to add %s with %s into %s\n", mats[mat1_idx]->name, mats[mat2_idx]->name,c->name);
-					return;	
-				}
-			}
+	else if (elementwise_command(cmd->cmds[0], cmd->num_cmds, &op, &scalar)) {
+		run_elementwise(cmd, mats, num_mats, op, scalar, out);
 	}
 	else if (strncmp(cmd->cmds[0],"duplicate",strlen("duplicate") + 1) == 0
-		&& cmd->num_cmds == 3 && strlen(cmd->cmds[1]) + 1 <= MATRIX_NAME_LEN) {
-		int mat1_idx = find_matrix_given_name(mats,num_mats,cmd->cmds[1]);
+		&& cmd->num_cmds == 3 && strlen(cmd->cmds[2]) + 1 <= MATRIX_NAME_LEN) {
+		int mat1_idx = find_matrix_given_name(out, mats,num_mats,cmd->cmds[1]);
 		if (mat1_idx >= 0 ) {
 				Matrix_t* dup_mat = NULL;
-				if( !create_matrix (&dup_mat,cmd->cmds[2], mats[mat1_idx]->rows, 
+				if( !create_matrix (out, &dup_mat,cmd->cmds[2], mats[mat1_idx]->rows, 
 						mats[mat1_idx]->cols)) {
 					return;
 				}
-				if(!duplicate_matrix(mats[mat1_idx], dup_mat)){
-					perror("Matrix duplication failed\n");
+				if(!duplicate_matrix(out, mats[mat1_idx], dup_mat)){
+					fprintf(out,"Matrix duplication failed\n");
 					return;
 				}else{
-					if(add_matrix_to_array(mats,dup_mat,num_mats)){
-						printf ("Duplication of %s into %s finished\n", mats[mat1_idx]->name, cmd->cmds[2]);
+					fprintf(out,"Duplication of %s into %s finished\n", mats[mat1_idx]->name, cmd->cmds[2]);
+					if(workspace_register(out, mats,dup_mat,num_mats) > num_mats){
+						fprintf(out,"\nMatrix %s failed to be added to the array.\n",cmd->cmds[2]);
 					}
 				}
 		}
 		else {
-			printf("Duplication Failed\n");
+			fprintf(out,"Duplication Failed\n");
 			return;
 		}
 	}
 	else if (strncmp(cmd->cmds[0],"equal",strlen("equal") + 1) == 0
-		&& cmd->num_cmds == 2) {
-			int mat1_idx = find_matrix_given_name(mats,num_mats,cmd->cmds[1]);
-			int mat2_idx = find_matrix_given_name(mats,num_mats,cmd->cmds[2]);
+		&& cmd->num_cmds == 3) {
+			int mat1_idx = find_matrix_given_name(out, mats,num_mats,cmd->cmds[1]);
+			int mat2_idx = find_matrix_given_name(out, mats,num_mats,cmd->cmds[2]);
 			if (mat1_idx >= 0 && mat2_idx >= 0) {
-				if ( equal_matrices(mats[mat1_idx],mats[mat2_idx]) ) {
-					printf("SAME DATA IN BOTH\n");
+				if ( equal_matrices(out, mats[mat1_idx],mats[mat2_idx]) ) {
+					fprintf(out,"SAME DATA IN BOTH\n");
 				}
 				else {
-					printf("DIFFERENT DATA IN BOTH\n");
+					fprintf(out,"DIFFERENT DATA IN BOTH\n");
 				}
 			}
 			else {
-				printf("Equal Failed\n");
+				fprintf(out,"Equal Failed\n");
 				return;
 			}
 	}
 	else if (strncmp(cmd->cmds[0],"shift",strlen("shift") + 1) == 0
 		&& cmd->num_cmds == 4) {
-		int mat1_idx = find_matrix_given_name(mats,num_mats,cmd->cmds[1]);
+		int mat1_idx = find_matrix_given_name(out, mats,num_mats,cmd->cmds[1]);
 		const int shift_value = atoi(cmd->cmds[3]);
 			if (mat1_idx >= 0 ) {
-				if(bitwise_shift_matrix(mats[mat1_idx],cmd->cmds[2][0], shift_value)){
-				printf("Matrix (%s) has been shifted by %d\n", mats[mat1_idx]->name, shift_value);
+				if(bitwise_shift_matrix(out, mats[mat1_idx],cmd->cmds[2][0], shift_value)){
+				fprintf(out,"Matrix (%s) has been shifted by %d\n", mats[mat1_idx]->name, shift_value);
 			}else{
-				perror("Bit shift failed.\n");
+				fprintf(out,"Bit shift failed.\n");
 				return;
 			}
 		}
 		else {
-			printf("Matrix shift failed\n");
+			fprintf(out,"Matrix shift failed\n");
 			return;
 		}
 
@@ -217,85 +264,521 @@ void run_commands (Commands_t* cmd, Matrix_t** mats, unsigned int num_mats) {
 	else if (strncmp(cmd->cmds[0],"read",strlen("read") + 1) == 0
 		&& cmd->num_cmds == 2) {
 		Matrix_t* new_matrix = NULL;
-		if(! read_matrix(cmd->cmds[1],&new_matrix)) {
-			printf("Read Failed\n");
+		if(! read_matrix(out, cmd->cmds[1],&new_matrix)) {
+			fprintf(out,"Read Failed\n");
 			return;
 		}	
 		
-		int pos1 = add_matrix_to_array(mats,new_matrix, num_mats);
+		int pos1 = workspace_register(out, mats,new_matrix, num_mats);
 		if(pos1 > num_mats){
-			printf("\nMatrix %s failed to be added to the array.\n",new_matrix->name);
+			fprintf(out,"\nMatrix %s failed to be added to the array.\n",new_matrix->name);
 		}
-		printf("Matrix (%s) is read from the filesystem\n", cmd->cmds[1]);	
+		fprintf(out,"Matrix (%s) is read from the filesystem\n", cmd->cmds[1]);	
 	}
 	else if (strncmp(cmd->cmds[0],"write",strlen("write") + 1) == 0
 		&& cmd->num_cmds == 2) {
-		int mat1_idx = find_matrix_given_name(mats,num_mats,cmd->cmds[1]);
-		if(! write_matrix(mats[mat1_idx]->name,mats[mat1_idx])) {
-			printf("Write Failed\n");
+		int mat1_idx = find_matrix_given_name(out, mats,num_mats,cmd->cmds[1]);
+		if (mat1_idx < 0) {
+			fprintf(out,"Matrix (%s) doesn't exist\n", cmd->cmds[1]);
+			return;
+		}
+		if(! write_matrix(out, mats[mat1_idx]->name,mats[mat1_idx])) {
+			fprintf(out,"Write Failed\n");
 			return;
 		}
 		else {
-			printf("Matrix (%s) is wrote out to the filesystem\n", mats[mat1_idx]->name);
+			fprintf(out,"Matrix (%s) is wrote out to the filesystem\n", mats[mat1_idx]->name);
 		}
 	}
 	else if (strncmp(cmd->cmds[0], "create", strlen("create") + 1) == 0
-		&& strlen(cmd->cmds[1]) + 1 <= MATRIX_NAME_LEN && cmd->num_cmds == 4) {
+		&& cmd->num_cmds == 4 && strlen(cmd->cmds[1]) + 1 <= MATRIX_NAME_LEN) {
 		Matrix_t* new_mat = NULL;
-		const unsigned int rows = atoi(cmd->cmds[2]);
-		const unsigned int cols = atoi(cmd->cmds[3]);
+		size_t rows = 0;
+		size_t cols = 0;
+		if (!parse_size(cmd->cmds[2], &rows) || !parse_size(cmd->cmds[3], &cols)) {
+			fprintf(out,"\nInvalid dimensions %s X %s\n",cmd->cmds[2],cmd->cmds[3]);
+			return;
+		}
 		
 		//Check if creation failed
-		if(!create_matrix(&new_mat,cmd->cmds[1],rows, cols)){
-			printf("\nCreation of matrix %s failed.\n",cmd->cmds[2]);
+		if(!create_matrix(out, &new_mat,cmd->cmds[1],rows, cols)){
+			fprintf(out,"\nCreation of matrix %s failed.\n",cmd->cmds[1]);
 			return;
 		}
 		//Check if matrix was added to array.
-		int pos2 = add_matrix_to_array(mats,new_mat,num_mats);
+		int pos2 = workspace_register(out, mats,new_mat,num_mats);
 		if(pos2>num_mats){ //means add failed
-			printf("\nMatrix %s failed to be added to array",new_mat->name);
+			fprintf(out,"\nMatrix %s failed to be added to array",new_mat->name);
+			return;
+		}
+		fprintf(out,"Created Matrix (%s,%zu,%zu)\n", new_mat->name, new_mat->rows, new_mat->cols);
+	}
+	else if (strncmp(cmd->cmds[0], "view", strlen("view") + 1) == 0
+		&& cmd->num_cmds == 7 && strlen(cmd->cmds[1]) + 1 <= MATRIX_NAME_LEN) {
+		size_t at[4];
+		for (unsigned int i = 0; i < 4; ++i) {
+			if (!parse_size(cmd->cmds[3 + i], &at[i])) {
+				fprintf(out,"\nInvalid view position or size %s\n",cmd->cmds[3 + i]);
+				return;
+			}
+		}
+		int mat1_idx = find_matrix_given_name(out, mats,num_mats,cmd->cmds[2]);
+		if (mat1_idx < 0) {
+			fprintf(out,"Matrix (%s) doesn't exist\n", cmd->cmds[2]);
+			return;
+		}
+		Matrix_t* v = NULL;
+		if (!create_view(out, &v,cmd->cmds[1],mats[mat1_idx],at[0],at[1],at[2],at[3])) {
+			fprintf(out,"\nCreation of view %s failed.\n",cmd->cmds[1]);
 			return;
 		}
-		printf("Created Matrix (%s,%u,%u)\n", new_mat->name, new_mat->rows, new_mat->cols);
+		if (workspace_register(out, mats,v,num_mats) > num_mats) {
+			fprintf(out,"\nView %s failed to be added to array\n",cmd->cmds[1]);
+			destroy_matrix(&v);
+			return;
+		}
+		fprintf(out,"View (%s) of %s at (%zu,%zu) is %zu X %zu\n", cmd->cmds[1], cmd->cmds[2],
+				at[0], at[1], at[2], at[3]);
 	}
 	else if (strncmp(cmd->cmds[0], "random", strlen("random") + 1) == 0
 		&& cmd->num_cmds == 4) {
-		int mat1_idx = find_matrix_given_name(mats,num_mats,cmd->cmds[1]);
+		int mat1_idx = find_matrix_given_name(out, mats,num_mats,cmd->cmds[1]);
 		const unsigned int start_range = atoi(cmd->cmds[2]);
 		const unsigned int end_range = atoi(cmd->cmds[3]);
-		if(random_matrix(mats[mat1_idx],start_range, end_range)){
-			printf("Attempts to fill matrix with random values failed. God save us.\n");
+		if (mat1_idx < 0) {
+			fprintf(out,"Matrix (%s) doesn't exist\n", cmd->cmds[1]);
+			return;
+		}
+		if(!random_matrix(out, mats[mat1_idx],start_range, end_range)){
+			fprintf(out,"Attempts to fill matrix with random values failed. God save us.\n");
 			return;
 		}
 
-		printf("Matrix (%s) is randomized between %u %u\n", mats[mat1_idx]->name, start_range, end_range);
+		fprintf(out,"Matrix (%s) is randomized between %u %u\n", mats[mat1_idx]->name, start_range, end_range);
+	}
+	else if (strncmp(cmd->cmds[0], "transpose", strlen("transpose") + 1) == 0
+		&& cmd->num_cmds == 2) {
+		int mat1_idx = find_matrix_given_name(out, mats,num_mats,cmd->cmds[1]);
+		if (mat1_idx < 0) {
+			fprintf(out,"Matrix (%s) doesn't exist\n", cmd->cmds[1]);
+			return;
+		}
+		if (!transpose_matrix_in_place(out, mats[mat1_idx])) {
+			fprintf(out,"Transpose Failed\n");
+			return;
+		}
+		fprintf(out,"Matrix (%s) has been transposed in place\n", mats[mat1_idx]->name);
+	}
+	else if (strncmp(cmd->cmds[0], "transpose", strlen("transpose") + 1) == 0
+		&& cmd->num_cmds == 3 && strlen(cmd->cmds[2]) + 1 <= MATRIX_NAME_LEN) {
+		int mat1_idx = find_matrix_given_name(out, mats,num_mats,cmd->cmds[1]);
+		if (mat1_idx < 0) {
+			fprintf(out,"Matrix (%s) doesn't exist\n", cmd->cmds[1]);
+			return;
+		}
+		Matrix_t* t = NULL;
+		if (!create_matrix(out, &t,cmd->cmds[2], mats[mat1_idx]->cols, mats[mat1_idx]->rows)) {
+			fprintf(out,"Failure to create the result Matrix (%s)\n", cmd->cmds[2]);
+			return;
+		}
+		if (!transpose_matrix(out, mats[mat1_idx], t)) {
+			fprintf(out,"Transpose Failed\n");
+			destroy_matrix(&t);
+			return;
+		}
+		fprintf(out,"Transpose of %s into %s finished\n", mats[mat1_idx]->name, t->name);
+		if (workspace_register(out, mats,t,num_mats) > num_mats) {
+			fprintf(out,"\nMatrix %s failed to be added to the array.\n",t->name);
+		}
+	}
+	else if (strncmp(cmd->cmds[0], "conv", strlen("conv") + 1) == 0
+		&& (cmd->num_cmds == 4 || cmd->num_cmds == 5)
+		&& strlen(cmd->cmds[3]) + 1 <= MATRIX_NAME_LEN) {
+		int mat1_idx = find_matrix_given_name(out, mats,num_mats,cmd->cmds[1]);
+		int mat2_idx = find_matrix_given_name(out, mats,num_mats,cmd->cmds[2]);
+		if (mat1_idx < 0) {
+			fprintf(out,"Matrix (%s) doesn't exist\n", cmd->cmds[1]);
+			return;
+		}
+		if (mat2_idx < 0) {
+			fprintf(out,"Matrix (%s) doesn't exist\n", cmd->cmds[2]);
+			return;
+		}
+		Boundary_t boundary = BOUNDARY_ZERO;
+		if (cmd->num_cmds == 5) {
+			if (strcmp(cmd->cmds[4], "clamp") == 0) {
+				boundary = BOUNDARY_CLAMP;
+			}
+			else if (strcmp(cmd->cmds[4], "wrap") == 0) {
+				boundary = BOUNDARY_WRAP;
+			}
+			else if (strcmp(cmd->cmds[4], "zero") != 0) {
+				fprintf(out,"Boundary (%s) should be zero, clamp or wrap\n", cmd->cmds[4]);
+				return;
+			}
+		}
+		Matrix_t* c = NULL;
+		if (!create_matrix(out, &c,cmd->cmds[3], mats[mat1_idx]->rows, mats[mat1_idx]->cols)) {
+			fprintf(out,"Failure to create the result Matrix (%s)\n", cmd->cmds[3]);
+			return;
+		}
+		if (!convolve_matrix(out, mats[mat1_idx], mats[mat2_idx], c, boundary)) {
+			fprintf(out,"Convolution Failed\n");
+			destroy_matrix(&c);
+			return;
+		}
+		fprintf(out,"Convolution of %s with %s into %s finished\n", mats[mat1_idx]->name,
+				mats[mat2_idx]->name, c->name);
+		if (workspace_register(out, mats,c,num_mats) > num_mats) {
+			fprintf(out,"\nMatrix %s failed to be added to the array.\n",c->name);
+		}
+	}
+	else if (strncmp(cmd->cmds[0], "sum", strlen("sum") + 1) == 0
+		&& cmd->num_cmds == 2) {
+		int mat1_idx = find_matrix_given_name(out, mats,num_mats,cmd->cmds[1]);
+		if (mat1_idx < 0) {
+			fprintf(out,"Matrix (%s) doesn't exist\n", cmd->cmds[1]);
+			return;
+		}
+		fprintf(out,"Sum of Matrix (%s) = %llu\n", mats[mat1_idx]->name, sum_matrix(out, mats[mat1_idx]));
+	}
+	else if ((strncmp(cmd->cmds[0], "rowsum", strlen("rowsum") + 1) == 0
+		|| strncmp(cmd->cmds[0], "colsum", strlen("colsum") + 1) == 0)
+		&& cmd->num_cmds == 3 && strlen(cmd->cmds[2]) + 1 <= MATRIX_NAME_LEN) {
+		const bool by_row = cmd->cmds[0][0] == 'r';
+		int mat1_idx = find_matrix_given_name(out, mats,num_mats,cmd->cmds[1]);
+		if (mat1_idx < 0) {
+			fprintf(out,"Matrix (%s) doesn't exist\n", cmd->cmds[1]);
+			return;
+		}
+		Matrix_t* r = NULL;
+		if (!create_matrix(out, &r,cmd->cmds[2], by_row ? mats[mat1_idx]->rows : 4,
+				by_row ? 4 : mats[mat1_idx]->cols)) {
+			fprintf(out,"Failure to create the result Matrix (%s)\n", cmd->cmds[2]);
+			return;
+		}
+		if (!reduction_matrix(out, mats[mat1_idx], r, by_row)) {
+			fprintf(out,"%s Failed\n", cmd->cmds[0]);
+			destroy_matrix(&r);
+			return;
+		}
+		fprintf(out,"%s of %s into %s finished (sum, min, max, count)\n", cmd->cmds[0],
+				mats[mat1_idx]->name, r->name);
+		if (workspace_register(out, mats,r,num_mats) > num_mats) {
+			fprintf(out,"\nMatrix %s failed to be added to the array.\n",r->name);
+		}
+	}
+	else if (strncmp(cmd->cmds[0], "hist", strlen("hist") + 1) == 0
+		&& cmd->num_cmds >= 2 && cmd->num_cmds <= 4) {
+		run_histogram(cmd, mats, num_mats, out);
+	}
+	else if (strncmp(cmd->cmds[0], "distinct", strlen("distinct") + 1) == 0
+		&& cmd->num_cmds == 2) {
+		int mat1_idx = find_matrix_given_name(out, mats,num_mats,cmd->cmds[1]);
+		if (mat1_idx < 0) {
+			fprintf(out,"Matrix (%s) doesn't exist\n", cmd->cmds[1]);
+			return;
+		}
+		unsigned long long distinct = 0;
+		if (!distinct_values(out, mats[mat1_idx], &distinct)) {
+			fprintf(out,"Distinct count Failed\n");
+			return;
+		}
+		fprintf(out,"Matrix (%s) has %llu distinct values among %zu elements\n", mats[mat1_idx]->name,
+				distinct, mats[mat1_idx]->rows * mats[mat1_idx]->cols);
+	}
+	else if (strncmp(cmd->cmds[0], "sort", strlen("sort") + 1) == 0
+		&& (cmd->num_cmds == 2 || (cmd->num_cmds == 3
+			&& (strcmp(cmd->cmds[2], "rows") == 0 || strcmp(cmd->cmds[2], "all") == 0)))) {
+		const bool by_row = cmd->num_cmds == 3 && strcmp(cmd->cmds[2], "rows") == 0;
+		int mat1_idx = find_matrix_given_name(out, mats,num_mats,cmd->cmds[1]);
+		if (mat1_idx < 0) {
+			fprintf(out,"Matrix (%s) doesn't exist\n", cmd->cmds[1]);
+			return;
+		}
+		if (!sort_matrix(out, mats[mat1_idx], by_row)) {
+			fprintf(out,"Sort Failed\n");
+			return;
+		}
+		fprintf(out,"Matrix (%s) has been sorted%s\n", mats[mat1_idx]->name, by_row ? " row by row" : "");
+	}
+	else if (strncmp(cmd->cmds[0], "topk", strlen("topk") + 1) == 0
+		&& cmd->num_cmds == 4 && strlen(cmd->cmds[3]) + 1 <= MATRIX_NAME_LEN) {
+		size_t k = 0;
+		if (!parse_size(cmd->cmds[2], &k)) {
+			fprintf(out,"Invalid k %s\n", cmd->cmds[2]);
+			return;
+		}
+		int mat1_idx = find_matrix_given_name(out, mats,num_mats,cmd->cmds[1]);
+		if (mat1_idx < 0) {
+			fprintf(out,"Matrix (%s) doesn't exist\n", cmd->cmds[1]);
+			return;
+		}
+		if (k == 0 || k > mats[mat1_idx]->cols) {
+			fprintf(out,"k should be between 1 and %zu\n", mats[mat1_idx]->cols);
+			return;
+		}
+		Matrix_t* t = NULL;
+		if (!create_matrix(out, &t,cmd->cmds[3], mats[mat1_idx]->rows, k)) {
+			fprintf(out,"Failure to create the result Matrix (%s)\n", cmd->cmds[3]);
+			return;
+		}
+		if (!top_k_matrix(out, mats[mat1_idx], k, t)) {
+			fprintf(out,"Top-k Failed\n");
+			destroy_matrix(&t);
+			return;
+		}
+		fprintf(out,"Largest %zu of each row of %s into %s finished\n", k, mats[mat1_idx]->name, t->name);
+		if (workspace_register(out, mats,t,num_mats) > num_mats) {
+			fprintf(out,"\nMatrix %s failed to be added to the array.\n",t->name);
+		}
+	}
+	else if ((strncmp(cmd->cmds[0], "median", strlen("median") + 1) == 0 && cmd->num_cmds == 2)
+		|| (strncmp(cmd->cmds[0], "percentile", strlen("percentile") + 1) == 0 && cmd->num_cmds == 3)) {
+		double percent = 50;
+		if (cmd->num_cmds == 3) {
+			char* end = NULL;
+			percent = strtod(cmd->cmds[2], &end);
+			if (end == cmd->cmds[2] || *end != '\0' || !(percent >= 0 && percent <= 100)) {
+				fprintf(out,"Percentile %s should be between 0 and 100\n", cmd->cmds[2]);
+				return;
+			}
+		}
+		int mat1_idx = find_matrix_given_name(out, mats,num_mats,cmd->cmds[1]);
+		if (mat1_idx < 0) {
+			fprintf(out,"Matrix (%s) doesn't exist\n", cmd->cmds[1]);
+			return;
+		}
+		const size_t n = mats[mat1_idx]->rows * mats[mat1_idx]->cols;
+		if (n == 0) {
+			fprintf(out,"Matrix (%s) is empty\n", mats[mat1_idx]->name);
+			return;
+		}
+		//Nearest rank: the smallest element at least percent of the elements are at or below.
+		const double position = percent / 100 * n;
+		size_t rank = (size_t) position;
+		rank = rank < position ? rank : (rank ? rank - 1 : 0);
+		rank = rank < n ? rank : n - 1;
+		unsigned int value = 0;
+		if (!rank_value(out, mats[mat1_idx], rank, &value)) {
+			fprintf(out,"%s Failed\n", cmd->cmds[0]);
+			return;
+		}
+		if (cmd->num_cmds == 2) {
+			fprintf(out,"Median of Matrix (%s) = %u\n", mats[mat1_idx]->name, value);
+		}
+		else {
+			fprintf(out,"%g percentile of Matrix (%s) = %u\n", percent, mats[mat1_idx]->name, value);
+		}
+	}
+	else if (strncmp(cmd->cmds[0], "save", strlen("save") + 1) == 0
+		&& cmd->num_cmds == 2) {
+		if (!save_workspace(out, cmd->cmds[1], mats, num_mats)) {
+			fprintf(out,"Save Failed\n");
+			return;
+		}
+		fprintf(out,"Workspace saved to %s\n", cmd->cmds[1]);
+	}
+	else if (strncmp(cmd->cmds[0], "load", strlen("load") + 1) == 0
+		&& cmd->num_cmds == 2) {
+		if (!load_workspace(out, cmd->cmds[1], mats, num_mats)) {
+			fprintf(out,"Load Failed\n");
+			return;
+		}
+		fprintf(out,"Workspace loaded from %s\n", cmd->cmds[1]);
+	}
+	else if (strncmp(cmd->cmds[0], "mem", strlen("mem") + 1) == 0
+		&& cmd->num_cmds == 1) {
+		Memory_Usage_t usage;
+		memory_usage(mats, num_mats, &usage);
+		fprintf(out,"Resident: %zu bytes in %u matrices\n", usage.resident_bytes, usage.num_resident);
+		fprintf(out,"Spilled:  %zu bytes in %u matrices\n", usage.spilled_bytes, usage.num_spilled);
+		if (usage.budget_bytes) {
+			fprintf(out,"Budget:   %zu bytes\n", usage.budget_bytes);
+		}
+		else {
+			fprintf(out,"Budget:   unlimited\n");
+		}
 	}
 	else {
-		printf("Not a command in this application\n");
+		fprintf(out,"Not a command in this application\n");
 	}
 
 }
 
  
+/* 
+ * PURPOSE: Runs an element-wise command, <op> a b dest, <op>scalar a y dest or
+ * 			clamp a y z dest. dest is written in place when it already exists
+ * 			with the size of a, otherwise it is created.
+ * INPUTS: 
+ * 		   cmd : the command
+ * 	       mats : list of matrices
+ * 	       num_mats : is the number of matrices in the list.
+ * 	       op, scalar : the operator and form, from elementwise_command
+ * 	       out : stream the command's results are printed to.
+ * RETURN: void
+ **/
+void run_elementwise (Commands_t* cmd, Matrix_t** mats, unsigned int num_mats,
+			Elementwise_Op_t op, bool scalar, FILE* out) {
+
+	const char* dest_name = cmd->cmds[cmd->num_cmds - 1];
+	if (strlen(dest_name) + 1 > MATRIX_NAME_LEN) {
+		fprintf(out,"Matrix name %s is too long\n", dest_name);
+		return;
+	}
+	unsigned int y = 0;
+	unsigned int z = 0;
+	if (scalar && (!parse_scalar(cmd->cmds[2], &y)
+		|| (op == ELEMENTWISE_CLAMP && !parse_scalar(cmd->cmds[3], &z)))) {
+		fprintf(out,"Invalid scalar for %s\n", cmd->cmds[0]);
+		return;
+	}
+	int a_idx = find_matrix_given_name(out, mats,num_mats,cmd->cmds[1]);
+	int b_idx = scalar ? a_idx : find_matrix_given_name(out, mats,num_mats,cmd->cmds[2]);
+	if (a_idx < 0 || b_idx < 0) {
+		fprintf(out,"Matrix (%s) doesn't exist\n", a_idx < 0 ? cmd->cmds[1] : cmd->cmds[2]);
+		return;
+	}
+	int c_idx = find_matrix_given_name(out, mats,num_mats,dest_name);
+	Matrix_t* a = mats[a_idx];
+	Matrix_t* b = mats[b_idx];
+	Matrix_t* c = NULL;
+	bool in_place = c_idx >= 0 && mats[c_idx]->rows == a->rows && mats[c_idx]->cols == a->cols;
+	if (in_place) {
+		c = mats[c_idx];
+	}
+	else if (!create_matrix(out, &c,dest_name,a->rows,a->cols)) {
+		fprintf(out,"Failure to create the result Matrix (%s)\n", dest_name);
+		return;
+	}
+
+	bool ok = scalar ? elementwise_scalar(out, op, a, y, z, c) : elementwise_matrices(out, op, a, b, c);
+	if (!ok) {
+		fprintf(out,"Failure to %s %s with %s into %s\n", cmd->cmds[0], cmd->cmds[1],
+				cmd->cmds[2], dest_name);
+		if (!in_place) {
+			destroy_matrix(&c);
+		}
+		return;
+	}
+	//Register only once the operands are no longer needed, c may replace one of them.
+	if (!in_place && workspace_register(out, mats,c,num_mats) > num_mats) {
+		fprintf(out,"\nMatrix %s failed to be added to the array\n", dest_name);
+		destroy_matrix(&c);
+		return;
+	}
+	if (op == ELEMENTWISE_CLAMP) {
+		fprintf(out,"Matrix (%s) = %s clamped to [%u,%u]\n", dest_name, cmd->cmds[1], y, z);
+	}
+	else {
+		fprintf(out,"Matrix (%s) = %s %s %s\n", dest_name, cmd->cmds[1], cmd->cmds[0], cmd->cmds[2]);
+	}
+}
+
+/* 
+ * PURPOSE: Runs hist a [bins] [dest]. Without dest each bin's range and count is
+ * 			printed, with it they are stored as the rows (low, high, count) of a
+ * 			new bins x 3 matrix dest. bins defaults to 16.
+ * INPUTS: 
+ * 		   cmd : the command
+ * 	       mats : list of matrices
+ * 	       num_mats : is the number of matrices in the list.
+ * 	       out : stream the command's results are printed to.
+ * RETURN: void
+ **/
+void run_histogram (Commands_t* cmd, Matrix_t** mats, unsigned int num_mats, FILE* out) {
+
+	unsigned int bins = 16;
+	if (cmd->num_cmds >= 3 && !parse_scalar(cmd->cmds[2], &bins)) {
+		fprintf(out,"Invalid bin count %s\n", cmd->cmds[2]);
+		return;
+	}
+	const char* dest_name = cmd->num_cmds == 4 ? cmd->cmds[3] : NULL;
+	if (dest_name && strlen(dest_name) + 1 > MATRIX_NAME_LEN) {
+		fprintf(out,"Matrix name %s is too long\n", dest_name);
+		return;
+	}
+	int mat1_idx = find_matrix_given_name(out, mats,num_mats,cmd->cmds[1]);
+	if (mat1_idx < 0) {
+		fprintf(out,"Matrix (%s) doesn't exist\n", cmd->cmds[1]);
+		return;
+	}
+	unsigned long long* counts = calloc(bins ? bins : 1, sizeof(unsigned long long));
+	if (!counts) {
+		fprintf(out,"Failure to allocate %u bins\n", bins);
+		return;
+	}
+	Histogram_t hist;
+	if (!histogram_matrix(out, mats[mat1_idx], bins, &hist, counts)) {
+		fprintf(out,"Histogram Failed\n");
+		free(counts);
+		return;
+	}
+
+	if (!dest_name) {
+		fprintf(out,"Histogram of %s, %u bins of %llu values\n", mats[mat1_idx]->name,
+				hist.bins, hist.width);
+		for (unsigned int b = 0; b < hist.bins; ++b) {
+			const unsigned long long low = hist.min + b * hist.width;
+			const unsigned long long high = b + 1 == hist.bins ? hist.max : low + hist.width - 1;
+			fprintf(out,"[%llu, %llu] %llu\n", low, high, counts[b]);
+		}
+		free(counts);
+		return;
+	}
+
+	Matrix_t* h = NULL;
+	if (!create_matrix(out, &h,dest_name,hist.bins,3)) {
+		fprintf(out,"Failure to create the result Matrix (%s)\n", dest_name);
+		free(counts);
+		return;
+	}
+	bool clamped = false;
+	for (unsigned int b = 0; b < hist.bins; ++b) {
+		const unsigned long long low = hist.min + b * hist.width;
+		h->data[b * h->stride] = low;
+		h->data[b * h->stride + 1] = b + 1 == hist.bins ? hist.max : low + hist.width - 1;
+		h->data[b * h->stride + 2] = counts[b] > UINT_MAX ? UINT_MAX : counts[b];
+		clamped = clamped || counts[b] > UINT_MAX;
+	}
+	free(counts);
+	fprintf(out,"Histogram of %s into %s finished (low, high, count)%s\n", mats[mat1_idx]->name,
+			h->name, clamped ? ", counts above 2^32 - 1 were clamped" : "");
+	if (workspace_register(out, mats,h,num_mats) > num_mats) {
+		fprintf(out,"\nMatrix %s failed to be added to the array.\n",h->name);
+	}
+}
+
 /* PURPOSE: Searches the array of matrices by comparing the name, given by the user to each
- * 			matrix's name.
+ * 			matrix's name. A matrix that was spilled to disk is loaded back into the
+ * 			array. The matrix found becomes the most recently used.
  * INPUTS: 
- * 		   
+ * 		   out : stream diagnostics are printed to
+ * 		   mats : list of matrices
+ * 		   num_mats : is the number of matrices in the list.
+ * 		   target : name of the matrix to find
  * RETURN: Either returns the index of matrix or returns -1 to indicate that the matrix was not found.
  **/
-unsigned int find_matrix_given_name (Matrix_t** mats, unsigned int num_mats, const char* target) {
-	//Check if mats empty
-	if(!(*mats)){
-		printf("\nArray of matrices empty\n");
+unsigned int find_matrix_given_name (FILE* out, Matrix_t** mats, unsigned int num_mats, const char* target) {
+	//Check if mats missing
+	if(!mats || !target){
+		fprintf(out,"\nArray of matrices or name is null\n");
 		return -1;
 	}
 
 	for (int i = 0; i < num_mats; ++i) {
-		if (strncmp(mats[i]->name,target,strlen(mats[i]->name)) == 0) {
+		if (mats[i] && strncmp(mats[i]->name,target,MATRIX_NAME_LEN) == 0) {
+			touch_matrix(mats[i]);
 			return i;
 		}
 	}
-	return -1;
+
+	int i = reload_spilled_matrix(out, mats, num_mats, target);
+	if (i >= 0) {
+		touch_matrix(mats[i]);
+	}
+	return i;
 }
 
 /* 
@@ -308,17 +791,91 @@ unsigned int find_matrix_given_name (Matrix_t** mats, unsigned int num_mats, con
  **/
 void destroy_remaining_heap_allocations(Matrix_t **mats, unsigned int num_mats) {
 	
-	//Check if array empty.
-	if(!(*mats)){
-		printf("Matrix array empty or &MatrixArray[0] null\n");
+	//Check if array missing.
+	if(!mats){
+		printf("Matrix array null\n");
 		return;
 		
 	}
 
 	for (int i = 0;i < num_mats;i++) {
 		if (mats[i] != NULL) {
-			free(mats[i]->data);
-			free(mats[i]->name);
+			destroy_matrix(&mats[i]);
 		}
 	}
 }
+
+/* 
+ * PURPOSE: Reads a byte count with an optional K, M, G or T (binary) suffix
+ * INPUTS:
+ *        text : the size, such as 8G
+ *        bytes : receives the size in bytes
+ *
+ * RETURN: True if text is a valid size.
+ **/
+bool parse_byte_size (const char* text, size_t* bytes) {
+
+	char* end = NULL;
+	errno = 0;
+	unsigned long long value = strtoull(text, &end, 10);
+	if (errno || end == text) {
+		return false;
+	}
+	unsigned int shift = 0;
+	switch (*end) {
+		case 'T': case 't': shift = 40; break;
+		case 'G': case 'g': shift = 30; break;
+		case 'M': case 'm': shift = 20; break;
+		case 'K': case 'k': shift = 10; break;
+		case '\0': break;
+		default: return false;
+	}
+	if (shift && end[1] != '\0' && !((end[1] == 'B' || end[1] == 'b') && end[2] == '\0')) {
+		return false;
+	}
+	if (value > (SIZE_MAX >> shift)) {
+		return false;
+	}
+	*bytes = (size_t) value << shift;
+	return true;
+}
+
+/* 
+ * PURPOSE: Reads an unsigned int operand of a command
+ * INPUTS:
+ *        text : the number, decimal or 0x hex
+ *        value : receives the number
+ *
+ * RETURN: True if text is a whole number that fits in an unsigned int.
+ **/
+bool parse_scalar (const char* text, unsigned int* value) {
+
+	char* end = NULL;
+	errno = 0;
+	unsigned long long v = strtoull(text, &end, 0);
+	if (errno || end == text || *end != '\0' || text[0] == '-' || v > UINT_MAX) {
+		return false;
+	}
+	*value = (unsigned int) v;
+	return true;
+}
+
+/* 
+ * PURPOSE: Reads a dimension or position operand of a command
+ * INPUTS:
+ *        text : the number, in decimal
+ *        value : receives the number
+ *
+ * RETURN: True if text is a whole number that fits in a size_t.
+ **/
+bool parse_size (const char* text, size_t* value) {
+
+	char* end = NULL;
+	errno = 0;
+	unsigned long long v = strtoull(text, &end, 10);
+	if (errno || end == text || *end != '\0' || text[0] == '-' || v > SIZE_MAX) {
+		return false;
+	}
+	*value = (size_t) v;
+	return true;
+}
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,22 +7,322 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stddef.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "matrix.h"
 
 
 #define MAX_CMD_COUNT 50
 
+/*
+ * Edge length of the leaf tiles the recursive transpose stops at. A 32x32
+ * tile of unsigned ints is 4 KiB, so a source tile and a destination tile
+ * both stay resident in L1 while the leaf kernel runs.
+ */
+#define TRANSPOSE_TILE 32
+
+/*
+ * Minimum number of elements a worker thread is given before a kernel is
+ * split across threads. Below this the cost of starting a thread outweighs
+ * the work it would do.
+ */
+#define PARALLEL_MIN_ELEMENTS (1u << 18)
+
+/*
+ * Bytes in a cache line. Per worker accumulators are padded to whole lines
+ * so no two workers write to the same line.
+ */
+#define CACHE_LINE_SIZE 64
+
+/*
+ * Matrix data of at least HUGE_PAGE_SIZE bytes is mapped on a huge page
+ * boundary so the kernel can back it with 2 MiB pages, which keeps TLB
+ * misses down when a kernel streams through a multi-gigabyte matrix.
+ * Anything smaller comes from the heap, aligned to a cache line.
+ */
+#define HUGE_PAGE_SIZE ((size_t) 2 << 20)
+
+/*
+ * Matrix file layout, written by write_matrix in host byte order:
+ *
+ *   MATRIX_MAGIC, then version as an unsigned int
+ *   name length as an unsigned int, then the name with its terminator
+ *   rows and cols as unsigned long longs
+ *   the elements, row after row
+ *
+ * Files from before the magic start straight with the name length.
+ */
+#define MATRIX_MAGIC "MATRX\0\0\1"
+#define MATRIX_VERSION 1
+
+/*
+ * Workspace archive layout, in host byte order:
+ *
+ *   Workspace_Header_t
+ *   Workspace_Entry_t  x count       the index
+ *   matrix data, each starting on a WORKSPACE_ALIGN boundary
+ *
+ * Aligned payloads let load_workspace map each matrix straight out of the
+ * file, so nothing is read until a matrix is first used.
+ */
+#define WORKSPACE_MAGIC "MATWS\0\0\1"
+#define WORKSPACE_ALIGN 4096
+
+typedef struct {
+	char magic[8];
+	unsigned int version;
+	unsigned int count;
+} Workspace_Header_t;
+
+typedef struct {
+	char name[MATRIX_NAME_LEN];
+	unsigned long long rows;
+	unsigned long long cols;
+	unsigned long long offset;
+	unsigned long long bytes;
+} Workspace_Entry_t;
+
+/*
+ * Kernel run over a contiguous band of rows [r0,r1) by one worker.
+ * thread is the index of the worker, in [0, threads).
+ */
+typedef void (*Row_Kernel_t) (void* arg, unsigned int thread, size_t r0, size_t r1);
+
+/*
+ * Four lanes of unsigned ints, the width of an SSE2 register. GCC lowers
+ * operations on it to SIMD instructions where the target has them and to
+ * scalar code where it does not.
+ */
+typedef unsigned int Lanes_t __attribute__ ((vector_size (16)));
+#define LANES (sizeof(Lanes_t) / sizeof(unsigned int))
+
+/* Two elements widened to 64 bits, for sums */
+typedef unsigned long long Wide_Lanes_t __attribute__ ((vector_size (16)));
+
+/*
+ * Every element-wise operator, as
+ *
+ *   OP(name, enum suffix, result for elements x y z, result for lanes X Y Z)
+ *
+ * where y and z are the second operand (an element of the second matrix or
+ * the scalars). ELEMENTWISE_KERNEL turns each entry into a row kernel with
+ * an unrolled lane loop, a scalar tail and a matrix and scalar form, so a
+ * new operator only needs a line here and an Elementwise_Op_t.
+ */
+#define ELEMENTWISE_OPS(OP) \
+	OP(add, ADD, x + y, X + Y) \
+	OP(sub, SUB, x - y, X - Y) \
+	OP(and, AND, x & y, X & Y) \
+	OP(or, OR, x | y, X | Y) \
+	OP(xor, XOR, x ^ y, X ^ Y) \
+	OP(min, MIN, x < y ? x : y, select_lanes((Lanes_t) (X < Y), X, Y)) \
+	OP(max, MAX, x > y ? x : y, select_lanes((Lanes_t) (X > Y), X, Y)) \
+	OP(mul, MUL, x * y, X * Y) \
+	OP(shl, SHL, y < 32 ? x << y : 0, (X << (Y & 31)) & (Lanes_t) (Y < 32)) \
+	OP(shr, SHR, y < 32 ? x >> y : 0, (X >> (Y & 31)) & (Lanes_t) (Y < 32)) \
+	OP(clamp, CLAMP, x < y ? y : (x > z ? z : x), \
+		select_lanes((Lanes_t) (X < Y), Y, select_lanes((Lanes_t) (X > Z), Z, X)))
+
+/* Shared state of an element-wise operator, c = a op b or c = a op (y,z) */
+typedef struct {
+	const Matrix_t* a;
+	const Matrix_t* b; /* null for the scalar form */
+	Matrix_t* c;
+	unsigned int y;
+	unsigned int z;
+} Elementwise_Args_t;
+
+/*
+ * Convolution works on tiles of CONV_TILE output columns, with accumulators
+ * small enough to stay in L1. Source rows are padded to a whole number of
+ * tiles so the vector loops over a tile never need a scalar remainder.
+ *
+ * Box kernels (every weight equal) with at least CONV_BOX_MIN_TAPS weights
+ * are summed from a summed-area table, which costs the same however large
+ * the box is. The table covers CONV_SAT_ROWS output rows at a time.
+ */
+#define CONV_TILE 512
+#define CONV_BOX_MIN_TAPS 25
+#define CONV_SAT_ROWS 64
+
+/*
+ * Histograms have at most HIST_MAX_BINS bins, each worker counting into its
+ * own copy so no counter is shared between cores.
+ *
+ * distinct marks values in a bitmap per worker when the matrix spans at most
+ * DISTINCT_BITMAP_RANGE values (and no more than DISTINCT_BITMAP_PER_ELEMENT
+ * per element, so the bitmaps are not much bigger than the matrix). Wider
+ * matrices are radix sorted and the runs of equal values counted.
+ *
+ * The radix sort scatters elements into RADIX_BUCKETS buckets by their top
+ * byte in parallel, then sorts the buckets on the remaining bytes, one
+ * worker per range of buckets. Buckets below RADIX_SMALL are insertion
+ * sorted instead.
+ */
+#define HIST_MAX_BINS (1u << 20)
+#define DISTINCT_BITMAP_RANGE (1ull << 24)
+#define DISTINCT_BITMAP_PER_ELEMENT 8
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1u << RADIX_BITS)
+#define RADIX_SMALL 64
+
+/* Shared state of a histogram */
+typedef struct {
+	const Matrix_t* m;
+	unsigned int min;
+	unsigned long long magic; /* ceil(2^64 / bin width), 0 when there is one bin */
+	bool direct; /* bins are one value wide, so a value's bin is value - min */
+	size_t stride; /* counters per worker, a whole number of cache lines */
+	unsigned long long* partial; /* stride counters per worker */
+} Histogram_Args_t;
+
+/* Shared state of a distinct count from bitmaps */
+typedef struct {
+	const Matrix_t* m;
+	unsigned int min;
+	size_t words; /* bitmap words per worker, a whole number of cache lines */
+	unsigned long long* bitmaps;
+} Distinct_Args_t;
+
+/* Shared state of a radix sort of every element of a matrix */
+typedef struct {
+	const Matrix_t* m;
+	size_t* counts; /* RADIX_BUCKETS top byte counts per worker, then their scatter offsets */
+	size_t starts[RADIX_BUCKETS + 1]; /* where each bucket starts in out */
+	unsigned int* out;
+	unsigned int* scratch;
+} Radix_Args_t;
+
+/* Shared state of a per row sort or top-k selection */
+typedef struct {
+	Matrix_t* m;
+	Matrix_t* dest; /* rows x k, for top-k */
+	size_t k;
+	bool failed; /* a worker could not allocate its row buffer */
+} Order_Args_t;
+
+/* Shared state of a convolution */
+typedef struct {
+	const Matrix_t* src;
+	const Matrix_t* kernel;
+	Matrix_t* dest;
+	Boundary_t boundary;
+	size_t padded_cols; /* src->cols rounded up to a whole number of tiles */
+	unsigned int* row_weights; /* separable kernel = col_weights x row_weights */
+	unsigned int* col_weights;
+	unsigned int box_weight; /* weight of every tap of a box kernel */
+	size_t clamped; /* results that did not fit in an unsigned int */
+	bool failed; /* a worker could not allocate its buffers */
+} Conv_Args_t;
+
+/*
+ * Shared state of a row or column reduction. reduce_cols gives each worker
+ * its own sums, mins and maxes, each padded to whole cache lines, so a
+ * worker's column loop runs over plain arrays a vector at a time.
+ */
+typedef struct {
+	Matrix_t* m;
+	Reduction_t* result;
+	size_t padded_cols; /* cols rounded up to a whole cache line of mins */
+	unsigned long long* sums; /* padded_cols per worker */
+	unsigned int* mins;
+	unsigned int* maxs;
+} Reduce_Args_t;
+
+/* A matrix whose data was moved out of memory into the scratch file */
+typedef struct {
+	char name[MATRIX_NAME_LEN];
+	size_t rows;
+	size_t cols;
+	off_t offset;
+	size_t bytes;
+} Spilled_Matrix_t;
+
+/* Least recently used bookkeeping and the spill store */
+static unsigned long long lru_clock = 0;
+static unsigned long long pin_epoch = 1;
+static size_t memory_budget = 0;
+static int spill_fd = -1;
+static off_t spill_end = 0;
+static size_t spilled_bytes = 0;
+static Spilled_Matrix_t* spilled = NULL;
+static unsigned int num_spilled = 0;
+static unsigned int spilled_cap = 0;
+
 /*protected functions*/
 void load_matrix (Matrix_t* m, unsigned int* data);
+static void enforce_budget (FILE* out, Matrix_t** mats, unsigned int num_mats, Matrix_t* except);
+static void forget_spilled_matrix (const char* name);
+static unsigned int least_recently_used (Matrix_t** mats, unsigned int num_mats, Matrix_t* except);
+static size_t matrix_bytes (const Matrix_t* m);
+static size_t resident_bytes (const Matrix_t* m);
+static bool is_contiguous (const Matrix_t* m);
+static bool blocks_overlap (const Matrix_t* a, const Matrix_t* b);
+static bool partly_overlap (const Matrix_t* a, const Matrix_t* b);
+static bool write_rows (int fd, const Matrix_t* m, off_t offset);
+static unsigned int* allocate_matrix_data (size_t bytes, size_t* mapped_bytes);
+static bool write_fully (int fd, const void* buf, size_t len, off_t offset);
+static bool read_fully (int fd, void* buf, size_t len, off_t offset);
+static unsigned int row_thread_count (size_t rows, size_t cols);
+static bool map_matrix (FILE* out, Matrix_t** m, const char* name, size_t rows, size_t cols,
+						int fd, off_t offset);
+static void merge_reduction (Reduction_t* a, const Reduction_t* b);
+static void reduce_rows_kernel (void* arg, unsigned int thread, size_t r0, size_t r1);
+static void reduce_cols_kernel (void* arg, unsigned int thread, size_t r0, size_t r1);
+static bool parallel_rows (FILE* out, unsigned int threads, size_t rows, Row_Kernel_t kernel, void* arg);
+static bool matrix_extent (FILE* out, Matrix_t* m, unsigned int* min, unsigned int* max);
+static void histogram_kernel (void* arg, unsigned int thread, size_t r0, size_t r1);
+static void distinct_kernel (void* arg, unsigned int thread, size_t r0, size_t r1);
+static bool radix_sort_matrix (FILE* out, const Matrix_t* m, unsigned int* sorted);
+static void radix_count_kernel (void* arg, unsigned int thread, size_t r0, size_t r1);
+static void radix_scatter_kernel (void* arg, unsigned int thread, size_t r0, size_t r1);
+static void radix_bucket_kernel (void* arg, unsigned int thread, size_t b0, size_t b1);
+static void radix_sort_keys (unsigned int* keys, unsigned int* scratch, size_t n, unsigned int bits);
+static void select_rank (unsigned int* values, size_t n, size_t rank);
+static void sort_rows_kernel (void* arg, unsigned int thread, size_t r0, size_t r1);
+static void top_k_kernel (void* arg, unsigned int thread, size_t r0, size_t r1);
+static bool separable_weights (const Matrix_t* kernel, unsigned int* row_weights,
+						unsigned int* col_weights);
+static void conv_direct_kernel (void* arg, unsigned int thread, size_t r0, size_t r1);
+static void conv_separable_kernel (void* arg, unsigned int thread, size_t r0, size_t r1);
+static void conv_box_kernel (void* arg, unsigned int thread, size_t r0, size_t r1);
+static bool elementwise (FILE* out, Elementwise_Op_t op, const Matrix_t* a, const Matrix_t* b,
+						unsigned int y, unsigned int z, Matrix_t* c);
+#define ELEMENTWISE_PROTOTYPE(NAME, ENUM, SCALAR, VECTOR) \
+static void elementwise_##NAME##_kernel (void* arg, unsigned int thread, size_t r0, size_t r1);
+ELEMENTWISE_OPS(ELEMENTWISE_PROTOTYPE)
+#undef ELEMENTWISE_PROTOTYPE
+
+#define ELEMENTWISE_ENTRY(NAME, ENUM, SCALAR, VECTOR) \
+	[ELEMENTWISE_##ENUM] = { #NAME, elementwise_##NAME##_kernel },
+static const struct {
+	const char* name;
+	Row_Kernel_t kernel;
+} elementwise_ops[ELEMENTWISE_NUM_OPS] = {
+	ELEMENTWISE_OPS(ELEMENTWISE_ENTRY)
+};
+#undef ELEMENTWISE_ENTRY
+static void transpose_recursive (const unsigned int* src, size_t src_stride,
+						unsigned int* dest, size_t dest_stride,
+						size_t r0, size_t r1, size_t c0, size_t c1);
+static void transpose_swap_tiles (unsigned int* data, size_t stride,
+						size_t bi, size_t bi_end, size_t bj, size_t bj_end);
 
 /* 
  * PURPOSE: instantiates a new matrix with the passed name, rows, cols 
  * 
  * INPUTS: 
+ *		   out : stream diagnostics are printed to
  *		   name : the name of the matrix limited to 50 characters 
  *  	   rows : the number of rows in the matrix
  *  	   cols : the number of cols in the matrix
@@ -30,27 +331,78 @@ void load_matrix (Matrix_t* m, unsigned int* data);
  *
  **/
 
-bool create_matrix (Matrix_t** new_matrix, const char* name, const unsigned int rows,
-						const unsigned int cols) {
-	
+bool create_matrix (FILE* out, Matrix_t** new_matrix, const char* name, const size_t rows,
+						const size_t cols) {
 	
+	unsigned int len = strlen(name) + 1; 
+	if (len > MATRIX_NAME_LEN) {
+		return false;
+	}
+	size_t bytes = 0;
+	if (__builtin_mul_overflow(rows, cols, &bytes)
+		|| __builtin_mul_overflow(bytes, sizeof(unsigned int), &bytes)) {
+		fprintf(out, "\nMatrix %s of %zu X %zu is too large\n", name, rows, cols);
+		return false;
+	}
 	*new_matrix = calloc(1,sizeof(Matrix_t));
 	if (!(*new_matrix)) {
 		return false;
 	}
-	(*new_matrix)->data = calloc(rows * cols,sizeof(unsigned int));
+	(*new_matrix)->data = allocate_matrix_data(bytes, &(*new_matrix)->mapped_bytes);
 	if (!(*new_matrix)->data) {
+		free(*new_matrix);
+		*new_matrix = NULL;
 		return false;
 	}
 	(*new_matrix)->rows = rows;
 	(*new_matrix)->cols = cols;
-	unsigned int len = strlen(name) + 1; 
-	if (len > MATRIX_NAME_LEN) {
-		return false;
-	}
+	(*new_matrix)->stride = cols;
+	pthread_rwlock_init(&(*new_matrix)->lock, NULL);
 	strncpy((*new_matrix)->name,name,len);
 	return true;
 
+}
+
+	/* 
+	 * PURPOSE: Creates a view of a block of a matrix. The view shares the parent's
+	 * 			data, so writes through either are seen by both, and keeps it
+	 * 			alive until the view is destroyed.
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   view : receives the new view
+	 * 		   name : the name of the view
+	 * 		   parent : matrix or view to look into
+	 * 		   r0, c0 : row and column of parent the view starts at
+	 * 		   rows, cols : size of the view
+	 * RETURN: True if the view was created. False if the block is outside parent.
+	 **/
+bool create_view (FILE* out, Matrix_t** view, const char* name, Matrix_t* parent, size_t r0, size_t c0,
+						size_t rows, size_t cols) {
+
+	if (!parent || strlen(name) + 1 > MATRIX_NAME_LEN) {
+		return false;
+	}
+	if (rows > parent->rows || r0 > parent->rows - rows
+		|| cols > parent->cols || c0 > parent->cols - cols) {
+		fprintf(out, "\nBlock at (%zu,%zu) of %zu X %zu is outside %s, which is %zu X %zu\n",
+				r0, c0, rows, cols, parent->name, parent->rows, parent->cols);
+		return false;
+	}
+	*view = calloc(1,sizeof(Matrix_t));
+	if (!(*view)) {
+		return false;
+	}
+	/* a view of a view shares the data of the matrix that owns it */
+	Matrix_t* owner = parent->parent ? parent->parent : parent;
+	(*view)->rows = rows;
+	(*view)->cols = cols;
+	(*view)->stride = parent->stride;
+	(*view)->data = parent->data + r0 * parent->stride + c0;
+	(*view)->parent = owner;
+	owner->views++;
+	pthread_rwlock_init(&(*view)->lock, NULL);
+	snprintf((*view)->name, MATRIX_NAME_LEN, "%s", name);
+	return true;
 }
 
 	/* 
@@ -66,133 +418,249 @@ void destroy_matrix (Matrix_t** m) {
 
 	if(!(*m)){
 		printf("\nMatrix array empty.");
+		return;
+	}
+	if ((*m)->views) {
+		/* views still look at the data, the last of them frees it */
+		(*m)->released = true;
+		*m = NULL;
+		return;
 	}
 	
-	free((*m)->data);
+	Matrix_t* parent = (*m)->parent;
+	pthread_rwlock_destroy(&(*m)->lock);
+	if (parent) {
+		/* the data belongs to the parent */
+	}
+	else if ((*m)->mapped_bytes) {
+		munmap((*m)->data, (*m)->mapped_bytes);
+	}
+	else {
+		free((*m)->data);
+	}
 	free(*m);
 	*m = NULL;
+	if (parent && --parent->views == 0 && parent->released) {
+		destroy_matrix(&parent);
+	}
 }
 
 	/* 
 	 * PURPOSE: Compares 2 matrices to see if they are equivalent
 	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
 	 * 		   a : Pointer to the first matrix	
 	 * 		   b : Pointer to the second matrix
 	 * 
 	 * RETURN: True if matrices are equal. False if matrices are not.
 	 **/
-bool equal_matrices (Matrix_t* a, Matrix_t* b) {
+bool equal_matrices (FILE* out, Matrix_t* a, Matrix_t* b) {
 
 	//Check that both matrices aren't null.
 	if(!a || !b){
-		printf("Check inputs, a matrix is null");
+		fprintf(out, "Check inputs, a matrix is null");
 		return false;
 	}
 
-	int result = memcmp(a->data,b->data, sizeof(unsigned int) * a->rows * a->cols);
-	if (result == 0) {
-		return true;
+	if (a->rows != b->rows || a->cols != b->cols) {
+		return false;
 	}
-	return false;
+	if (is_contiguous(a) && is_contiguous(b)) {
+		return memcmp(a->data,b->data, matrix_bytes(a)) == 0;
+	}
+	for (size_t i = 0; i < a->rows; ++i) {
+		if (memcmp(&a->data[i * a->stride], &b->data[i * b->stride],
+				a->cols * sizeof(unsigned int)) != 0) {
+			return false;
+		}
+	}
+	return true;
 }
 
 	/* 
 	 * PURPOSE: To make a copy of a matrix
 	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
 	 * 		   src : Pointer to matrix that is the source for copying.
 	 * 		   dest : Pointer to the matrix that is to be coppied into.
 	 * 
 	 * RETURN: True if the copy successful. False if either the source is NULL or if th
 	 * 		   copy was unsuccessful.
 	 **/
-bool duplicate_matrix (Matrix_t* src, Matrix_t* dest) {
+bool duplicate_matrix (FILE* out, Matrix_t* src, Matrix_t* dest) {
 
 	if (!src) {
-		printf("\nSource cannot be null.\n");
+		fprintf(out, "\nSource cannot be null.\n");
+		return false;
+	}
+	if (!dest || src->rows != dest->rows || src->cols != dest->cols) {
+		fprintf(out, "\nDestination must be the same size as the source.\n");
 		return false;
 	}
 	/*
-	 * copy over data
+	 * copy over data, a row at a time when either is a view
 	 */
-	unsigned int bytesToCopy = sizeof(unsigned int) * src->rows * src->cols;
-	memcpy(dest->data,src->data, bytesToCopy);	
-	return equal_matrices (src,dest);
+	if (is_contiguous(src) && is_contiguous(dest)) {
+		memcpy(dest->data,src->data, matrix_bytes(src));
+	}
+	else {
+		for (size_t i = 0; i < src->rows; ++i) {
+			memmove(&dest->data[i * dest->stride], &src->data[i * src->stride],
+					src->cols * sizeof(unsigned int));
+		}
+	}
+	return equal_matrices (out, src,dest);
 }
 
 	/* 
 	 * PURPOSE: Bit shift inputed matrix 
 	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
 	 * 		   a : matrix to be shifted.
 	 * 		   direction : character representing the direction to shift the matrix
 	 * 		   shift : how many bits to shift the matrix,   
 	 * RETURN:
 	 **/
-bool bitwise_shift_matrix (Matrix_t* a, char direction, unsigned int shift) {
+bool bitwise_shift_matrix (FILE* out, Matrix_t* a, char direction, unsigned int shift) {
 	
 	//If matrix is null
 	if(!a){
-		perror("Matrix is null and cannont be shifted\n");
+		fprintf(out, "Matrix is null and cannont be shifted: %s\n", strerror(errno));
 		return false;
 	}
 	
 	//Check direction is either l or r	
 	if (direction == 'l' || direction == 'L') {
-		unsigned int i = 0;
-		for (; i < a->rows; ++i) {
-			unsigned int j = 0;
-			for (; j < a->cols; ++j) {
-				a->data[i * a->cols + j] = a->data[i * a->cols + j] << shift;
-			}
-		}
-
+		return elementwise_scalar(out, ELEMENTWISE_SHL, a, shift, 0, a);
 	}
 	else if(direction == 'r' || direction == 'R'){
-		unsigned int i = 0;
-		for (; i < a->rows; ++i) {
-			unsigned int j = 0;
-			for (; j < a->cols; ++j) {
-				a->data[i * a->cols + j] = a->data[i * a->cols + j] >> shift;
-			}
-		}
+		return elementwise_scalar(out, ELEMENTWISE_SHR, a, shift, 0, a);
 	}else{
-		printf("\nInvalid direction to shift\n");
+		fprintf(out, "\nInvalid direction to shift\n");
 		return false;
 	}
-	
-	return true;
 }
 
 	/* 
 	 * PURPOSE: To take 2 a,b matrices, of the same size and add them together to make a 3rd, c
 	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
 	 * 		   a : pointer to a matrix to be added
 	 * 		   b : pointer to another matrix to be added
 	 * 		   c : pointer to the resulting matrix of a+b
 	 *  
 	 * RETURN: Returns boolean value indicating whether the operation
 	 **/
-bool add_matrices (Matrix_t* a, Matrix_t* b, Matrix_t* c) {
-	
-	//Check to see if matrices are null
+bool add_matrices (FILE* out, Matrix_t* a, Matrix_t* b, Matrix_t* c) {
+	return elementwise_matrices(out, ELEMENTWISE_ADD, a, b, c);
+}
+
+	/* 
+	 * PURPOSE: Applies an element-wise operator to two matrices of the same size, c = a op b
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   op : the operator, any but ELEMENTWISE_CLAMP
+	 * 		   a : pointer to the first operand
+	 * 		   b : pointer to the second operand
+	 * 		   c : pointer to the result, the same size as a, may be a or b
+	 *  
+	 * RETURN: True if c was filled. False if the sizes differ or op has no matrix form.
+	 **/
+bool elementwise_matrices (FILE* out, Elementwise_Op_t op, Matrix_t* a, Matrix_t* b, Matrix_t* c) {
+
 	if(!a || !b || !c){
-		printf("\nCheck inputs a matrix pointer may me null.\n");
+		fprintf(out, "\nCheck inputs a matrix pointer may me null.\n");
 		return false;
 	}
-	
-	
-
-	if (a->rows != b->rows && a->cols != b->cols) {
-		printf("\nIncompatible matrix sizes:\nMatrix 1 is: %d X %d\nMatrix 2 is: %d X %d",
+	if (op >= ELEMENTWISE_NUM_OPS || op == ELEMENTWISE_CLAMP) {
+		fprintf(out, "\nOperator has no matrix form\n");
+		return false;
+	}
+	if (a->rows != b->rows || a->cols != b->cols) {
+		fprintf(out, "\nIncompatible matrix sizes:\nMatrix 1 is: %zu X %zu\nMatrix 2 is: %zu X %zu\n",
 				a->rows,a->cols,b->rows,b->cols);
 		return false;
 	}
+	return elementwise(out, op, a, b, 0, 0, c);
+}
+
+	/* 
+	 * PURPOSE: Applies an element-wise operator between a matrix and scalars, c = a op (y,z)
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   op : the operator
+	 * 		   a : pointer to the matrix operand
+	 * 		   y : the scalar operand, the lower bound for ELEMENTWISE_CLAMP
+	 * 		   z : the upper bound for ELEMENTWISE_CLAMP, ignored otherwise
+	 * 		   c : pointer to the result, the same size as a, may be a
+	 *  
+	 * RETURN: True if c was filled. False for a bad operator or clamp range.
+	 **/
+bool elementwise_scalar (FILE* out, Elementwise_Op_t op, Matrix_t* a, unsigned int y, unsigned int z, Matrix_t* c) {
+
+	if(!a || !c){
+		fprintf(out, "\nCheck inputs a matrix pointer may me null.\n");
+		return false;
+	}
+	if (op >= ELEMENTWISE_NUM_OPS) {
+		fprintf(out, "\nUnknown element-wise operator\n");
+		return false;
+	}
+	if (op == ELEMENTWISE_CLAMP && y > z) {
+		fprintf(out, "\nClamp range %u %u is empty\n", y, z);
+		return false;
+	}
+	return elementwise(out, op, a, NULL, y, z, c);
+}
+
+	/* 
+	 * PURPOSE: Recognises the element-wise commands, which are
+	 * 				<op> a b dest			for every operator but clamp
+	 * 				<op>scalar a y dest		for every operator but clamp
+	 * 				clamp a y z dest
+	 * INPUTS: 
+	 * 		   name : the command name
+	 * 		   num_cmds : the number of words in the command, the name included
+	 * 		   op : receives the operator
+	 * 		   scalar : receives whether the second operand is a scalar
+	 *  
+	 * RETURN: True if name and num_cmds are an element-wise command.
+	 **/
+bool elementwise_command (const char* name, unsigned int num_cmds, Elementwise_Op_t* op, bool* scalar) {
 
-	for (int i = 0; i < a->rows; ++i) {
-		for (int j = 0; j < b->cols; ++j) {
-			c->data[i * a->cols +j] = a->data[i * a->cols + j] + b->data[i * a->cols + j];
+	if (strcmp(name, elementwise_ops[ELEMENTWISE_CLAMP].name) == 0) {
+		*op = ELEMENTWISE_CLAMP;
+		*scalar = true;
+		return num_cmds == 5;
+	}
+	if (num_cmds != 4) {
+		return false;
+	}
+	for (unsigned int i = 0; i < ELEMENTWISE_NUM_OPS; ++i) {
+		if (i == ELEMENTWISE_CLAMP) {
+			continue;
+		}
+		size_t len = strlen(elementwise_ops[i].name);
+		if (strncmp(name, elementwise_ops[i].name, len) != 0) {
+			continue;
+		}
+		if (name[len] == '\0' || strcmp(&name[len], "scalar") == 0) {
+			*op = i;
+			*scalar = name[len] != '\0';
+			return true;
 		}
 	}
-	return true;
+	return false;
+}
+
+	/* 
+	 * PURPOSE: Names an element-wise operator
+	 * INPUTS: 
+	 * 		   op : the operator
+	 * RETURN: The operator's command name, such as "xor"
+	 **/
+const char* elementwise_op_name (Elementwise_Op_t op) {
+	return op < ELEMENTWISE_NUM_OPS ? elementwise_ops[op].name : "?";
 }
 
 	/* 
@@ -203,22 +671,34 @@ bool add_matrices (Matrix_t* a, Matrix_t* b, Matrix_t* c) {
 	 * RETURN: void
 	 **/
 void display_matrix (Matrix_t* m) {
+	fdisplay_matrix(stdout, m);
+}
+
+	/* 
+	 * PURPOSE: Prints the contents of the given matrix to a stream
+	 * INPUTS: 
+	 * 	       out : stream to print to
+	 * 	       m : matrix pointer
+	 * 
+	 * RETURN: void
+	 **/
+void fdisplay_matrix (FILE* out, Matrix_t* m) {
 	
 	if(!m){
-		printf("\nInput matrix is null\n");
+		fprintf(out, "\nInput matrix is null\n");
 		return;
 	}
 
 
-	printf("\nMatrix Contents (%s):\n", m->name);
-	printf("DIM = (%u,%u)\n", m->rows, m->cols);
-	for (int i = 0; i < m->rows; ++i) {
-		for (int j = 0; j < m->cols; ++j) {
-			printf("%u ", m->data[i * m->cols + j]);
+	fprintf(out, "\nMatrix Contents (%s):\n", m->name);
+	fprintf(out, "DIM = (%zu,%zu)\n", m->rows, m->cols);
+	for (size_t i = 0; i < m->rows; ++i) {
+		for (size_t j = 0; j < m->cols; ++j) {
+			fprintf(out, "%u ", m->data[i * m->stride + j]);
 		}
-		printf("\n");
+		fprintf(out, "\n");
 	}
-	printf("\n");
+	fprintf(out, "\n");
 
 }
 
@@ -226,133 +706,118 @@ void display_matrix (Matrix_t* m) {
 	 * PURPOSE: Opens stored matrix file, attempts to read from file. If successful, 
 	 * 			creates a matrix and loads it into
 	 * INPUTS: 
+	 * 	       out : stream diagnostics are printed to
 	 * 	       matrix_input_filename : file name of matrix to be read from file.
 	 * 		   m : list of matrices
 	 * RETURN: True if matrix read successfully. False if read failed.
 	 **/
-bool read_matrix (const char* matrix_input_filename, Matrix_t** m) {
+bool read_matrix (FILE* out, const char* matrix_input_filename, Matrix_t** m) {
 
 	int fd = open(matrix_input_filename,O_RDONLY);
 	if (fd < 0) {
-		printf("FAILED TO OPEN FOR READING\n");
+		fprintf(out, "FAILED TO OPEN FOR READING\n");
 		if (errno == EACCES ) {
-			perror("DO NOT HAVE ACCESS TO FILE\n");
+			fprintf(out, "DO NOT HAVE ACCESS TO FILE: %s\n", strerror(errno));
 		}
 		else if (errno == EADDRINUSE ){
-			perror("FILE ALREADY IN USE\n");
+			fprintf(out, "FILE ALREADY IN USE: %s\n", strerror(errno));
 		}
 		else if (errno == EBADF) {
-			perror("BAD FILE DESCRIPTOR\n");	
+			fprintf(out, "BAD FILE DESCRIPTOR: %s\n", strerror(errno));	
 		}
 		else if (errno == EEXIST) {
-			perror("FILE EXIST\n");
+			fprintf(out, "FILE EXIST: %s\n", strerror(errno));
 		}
 		return false;
 	}
 
-	/*read the wrote dimensions and name length*/
+	/*
+	 * read the magic and version, then the wrote name length, name and
+	 * dimensions. The dimensions are stored as 64 bit values so matrices
+	 * past 4G elements round trip.
+	 */
+	char magic[sizeof(MATRIX_MAGIC) - 1];
+	unsigned int version = 0;
 	unsigned int name_len = 0;
-	unsigned int rows = 0;
-	unsigned int cols = 0;
-	
-	if (read(fd,&name_len,sizeof(unsigned int)) != sizeof(unsigned int)) {
-		printf("FAILED TO READING FILE\n");
-		if (errno == EACCES ) {
-			perror("DO NOT HAVE ACCESS TO FILE\n");
-		}
-		else if (errno == EADDRINUSE ){
-			perror("FILE ALREADY IN USE\n");
-		}
-		else if (errno == EBADF) {
-			perror("BAD FILE DESCRIPTOR\n");	
+	unsigned long long rows = 0;
+	unsigned long long cols = 0;
+	char name_buffer[MATRIX_NAME_LEN];
+	off_t offset = 0;
+
+	if (!read_fully(fd, magic, sizeof(magic), offset)
+		|| memcmp(magic, MATRIX_MAGIC, sizeof(magic))) {
+		memcpy(&name_len, magic, sizeof(unsigned int));
+		if (name_len > 0 && name_len <= MATRIX_NAME_LEN) {
+			fprintf(out, "%s WAS WRITTEN BY AN OLDER BUILD WITHOUT A FORMAT VERSION, WRITE IT AGAIN\n",
+					matrix_input_filename);
 		}
-		else if (errno == EEXIST) {
-			perror("FILE EXIST\n");
+		else {
+			fprintf(out, "%s IS NOT A MATRIX FILE\n", matrix_input_filename);
 		}
+		close(fd);
 		return false;
 	}
-	char name_buffer[50];
-	if (read (fd,name_buffer,sizeof(char) * name_len) != sizeof(char) * name_len) {
-		printf("FAILED TO READ MATRIX NAME\n");
-		if (errno == EACCES ) {
-			perror("DO NOT HAVE ACCESS TO FILE\n");
-		}
-		else if (errno == EADDRINUSE ){
-			perror("FILE ALREADY IN USE\n");
-		}
-		else if (errno == EBADF) {
-			perror("BAD FILE DESCRIPTOR\n");	
-		}
-		else if (errno == EEXIST) {
-			perror("FILE EXIST\n");
-		}
-
-		return false;	
+	offset += sizeof(magic);
+	if (!read_fully(fd, &version, sizeof(unsigned int), offset) || version != MATRIX_VERSION) {
+		fprintf(out, "%s HAS MATRIX FORMAT VERSION %u, THIS BUILD READS VERSION %u\n",
+				matrix_input_filename, version, MATRIX_VERSION);
+		close(fd);
+		return false;
 	}
-
-	if (read (fd,&rows, sizeof(unsigned int)) != sizeof(unsigned int)) {
-		printf("FAILED TO READ MATRIX ROW SIZE\n");
-		if (errno == EACCES ) {
-			perror("DO NOT HAVE ACCESS TO FILE\n");
-		}
-		else if (errno == EADDRINUSE ){
-			perror("FILE ALREADY IN USE\n");
-		}
-		else if (errno == EBADF) {
-			perror("BAD FILE DESCRIPTOR\n");	
-		}
-		else if (errno == EEXIST) {
-			perror("FILE EXIST\n");
-		}
-
+	offset += sizeof(unsigned int);
+	name_len = 0;
+	if (!read_fully(fd, &name_len, sizeof(unsigned int), offset)
+		|| name_len == 0 || name_len > MATRIX_NAME_LEN) {
+		fprintf(out, "FAILED TO READ MATRIX NAME LENGTH\n");
+		close(fd);
 		return false;
 	}
-
-	if (read(fd,&cols,sizeof(unsigned int)) != sizeof(unsigned int)) {
-		printf("FAILED TO READ MATRIX COLUMN SIZE\n");
-		if (errno == EACCES ) {
-			perror("DO NOT HAVE ACCESS TO FILE\n");
-		}
-		else if (errno == EADDRINUSE ){
-			perror("FILE ALREADY IN USE\n");
-		}
-		else if (errno == EBADF) {
-			perror("BAD FILE DESCRIPTOR\n");	
-		}
-		else if (errno == EEXIST) {
-			perror("FILE EXIST\n");
-		}
-
+	offset += sizeof(unsigned int);
+	if (!read_fully(fd, name_buffer, name_len, offset) || name_buffer[name_len - 1] != '\0') {
+		fprintf(out, "FAILED TO READ MATRIX NAME\n");
+		close(fd);
 		return false;
 	}
+	offset += name_len;
+	if (!read_fully(fd, &rows, sizeof(unsigned long long), offset)) {
+		fprintf(out, "FAILED TO READ MATRIX ROW SIZE\n");
+		close(fd);
+		return false;
+	}
+	offset += sizeof(unsigned long long);
+	if (!read_fully(fd, &cols, sizeof(unsigned long long), offset)) {
+		fprintf(out, "FAILED TO READ MATRIX COLUMN SIZE\n");
+		close(fd);
+		return false;
+	}
+	offset += sizeof(unsigned long long);
 
-	unsigned int numberOfDataBytes = rows * cols * sizeof(unsigned int);
-	unsigned int *data = calloc(rows * cols, sizeof(unsigned int));
-	if (read(fd,data,numberOfDataBytes) != numberOfDataBytes) {
-		printf("FAILED TO READ MATRIX DATA\n");
-		if (errno == EACCES ) {
-			perror("DO NOT HAVE ACCESS TO FILE\n");
-		}
-		else if (errno == EADDRINUSE ){
-			perror("FILE ALREADY IN USE\n");
-		}
-		else if (errno == EBADF) {
-			perror("BAD FILE DESCRIPTOR\n");	
-		}
-		else if (errno == EEXIST) {
-			perror("FILE EXIST\n");
-		}
-
-		return false;	
+	/* the header must describe data the file actually holds before anything is allocated */
+	struct stat st;
+	unsigned long long bytes = 0;
+	if (fstat(fd, &st) || __builtin_mul_overflow(rows, cols, &bytes)
+		|| __builtin_mul_overflow(bytes, sizeof(unsigned int), &bytes)
+		|| bytes > SIZE_MAX || (unsigned long long) st.st_size < (unsigned long long) offset
+		|| bytes > (unsigned long long) st.st_size - offset) {
+		fprintf(out, "MATRIX %s IS LARGER THAN ITS FILE\n", name_buffer);
+		close(fd);
+		return false;
 	}
 
-	if (!create_matrix(m,name_buffer,rows,cols)) {
+	/* read straight into the new matrix rather than through a staging buffer */
+	if (!create_matrix(out, m,name_buffer,rows,cols)) {
+		close(fd);
+		return false;
+	}
+	if (!read_fully(fd, (*m)->data, matrix_bytes(*m), offset)) {
+		fprintf(out, "FAILED TO READ MATRIX DATA\n");
+		destroy_matrix(m);
+		close(fd);
 		return false;
 	}
 
-	load_matrix(*m,data);
-	free(data);
 	if (close(fd)) {
+		destroy_matrix(m);
 		return false;
 
 	}
@@ -362,71 +827,74 @@ bool read_matrix (const char* matrix_input_filename, Matrix_t** m) {
 	/* 
 	 * PURPOSE: To write a matrix to a file for usage latter.
 	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
 	 * 		   matrix_output_filename : name of file that matrix will be stored in.
 	 * 
 	 * RETURN: True if write successful. False if writing of matrix to file failed.
 	 **/
-bool write_matrix (const char* matrix_output_filename, Matrix_t* m) {
+bool write_matrix (FILE* out, const char* matrix_output_filename, Matrix_t* m) {
 
 	int fd = open(matrix_output_filename, O_CREAT | O_RDWR | O_TRUNC, 0644);
 	/* ERROR HANDLING USING errorno*/
 	if (fd < 0) {
-		printf("FAILED TO CREATE/OPEN FILE FOR WRITING\n");
+		fprintf(out, "FAILED TO CREATE/OPEN FILE FOR WRITING\n");
 		if (errno == EACCES ) {
-			perror("DO NOT HAVE ACCESS TO FILE\n");
+			fprintf(out, "DO NOT HAVE ACCESS TO FILE: %s\n", strerror(errno));
 		}
 		else if (errno == EADDRINUSE ){
-			perror("FILE ALREADY IN USE\n");
+			fprintf(out, "FILE ALREADY IN USE: %s\n", strerror(errno));
 		}
 		else if (errno == EBADF) {
-			perror("BAD FILE DESCRIPTOR\n");	
+			fprintf(out, "BAD FILE DESCRIPTOR: %s\n", strerror(errno));	
 		}
 		else if (errno == EEXIST) {
-			perror("FILE EXISTS\n");
+			fprintf(out, "FILE EXISTS: %s\n", strerror(errno));
 		}
 		return false;
 	}
-	/* Calculate the needed buffer for our matrix */
-	unsigned int name_len = strlen(m->name) + 1;
-	unsigned int numberOfBytes = sizeof(unsigned int) + (sizeof(unsigned int)  * 2) + name_len + sizeof(unsigned int) * m->rows * m->cols + 1;
-	/* Allocate the output_buffer in bytes
-	 * IMPORTANT TO UNDERSTAND THIS WAY OF MOVING MEMORY
+	/*
+	 * Only the small header is staged, the data is written straight out of
+	 * the matrix so a large matrix is never held in memory twice.
 	 */
-	unsigned char* output_buffer = calloc(numberOfBytes,sizeof(unsigned char));
-	unsigned int offset = 0;
-	memcpy(&output_buffer[offset], &name_len, sizeof(unsigned int)); // IMPORTANT C FUNCTION TO KNOW
+	const unsigned int version = MATRIX_VERSION;
+	unsigned int name_len = strlen(m->name) + 1;
+	unsigned long long rows = m->rows;
+	unsigned long long cols = m->cols;
+	unsigned char header[sizeof(MATRIX_MAGIC) - 1 + sizeof(unsigned int) * 2 + MATRIX_NAME_LEN
+			+ sizeof(unsigned long long) * 2];
+	size_t offset = 0;
+	memcpy(&header[offset], MATRIX_MAGIC, sizeof(MATRIX_MAGIC) - 1);
+	offset += sizeof(MATRIX_MAGIC) - 1;
+	memcpy(&header[offset], &version, sizeof(unsigned int));
+	offset += sizeof(unsigned int);
+	memcpy(&header[offset], &name_len, sizeof(unsigned int));
 	offset += sizeof(unsigned int);	
-	memcpy(&output_buffer[offset], m->name,name_len);
+	memcpy(&header[offset], m->name,name_len);
 	offset += name_len;
-	memcpy(&output_buffer[offset],&m->rows,sizeof(unsigned int));
-	offset += sizeof(unsigned int);
-	memcpy(&output_buffer[offset],&m->cols,sizeof(unsigned int));
-	offset += sizeof(unsigned int);
-	memcpy (&output_buffer[offset],m->data,m->rows * m->cols * sizeof(unsigned int));
-	offset += (m->rows * m->cols * sizeof(unsigned int));
-	output_buffer[numberOfBytes - 1] = EOF;
+	memcpy(&header[offset],&rows,sizeof(unsigned long long));
+	offset += sizeof(unsigned long long);
+	memcpy(&header[offset],&cols,sizeof(unsigned long long));
+	offset += sizeof(unsigned long long);
 
-	if (write(fd,output_buffer,numberOfBytes) != numberOfBytes) {
-		printf("FAILED TO WRITE MATRIX TO FILE\n");
+	if (!write_fully(fd, header, offset, 0)
+		|| !write_rows(fd, m, offset)) {
+		fprintf(out, "FAILED TO WRITE MATRIX TO FILE\n");
 		if (errno == EACCES ) {
-			perror("DO NOT HAVE ACCESS TO FILE\n");
+			fprintf(out, "DO NOT HAVE ACCESS TO FILE: %s\n", strerror(errno));
 		}
-		else if (errno == EADDRINUSE ){
-			perror("FILE ALREADY IN USE\n");
+		else if (errno == ENOSPC) {
+			fprintf(out, "NO SPACE LEFT ON DEVICE: %s\n", strerror(errno));
 		}
 		else if (errno == EBADF) {
-			perror("BAD FILE DESCRIPTOR\n");	
-		}
-		else if (errno == EEXIST) {
-			perror("FILE EXIST\n");
+			fprintf(out, "BAD FILE DESCRIPTOR: %s\n", strerror(errno));	
 		}
+		close(fd);
 		return false;
 	}
 	
 	if (close(fd)) {
 		return false;
 	}
-	free(output_buffer);
 
 	return true;
 }
@@ -435,72 +903,2572 @@ bool write_matrix (const char* matrix_output_filename, Matrix_t* m) {
 	 * PURPOSE: To fill a given matrix with random unsigned int data between
 	 * 			a upper and lower bound set by the user. 
 	 * INPUTS: 
+	 * 	       out : stream diagnostics are printed to
 	 * 	       m : matrix to fill
 	 * 		   start_range : lower bound of random values to put in matrix
 	 * 		   end_range : upper bound of random values to put in matrix
 	 * RETURN: True if matrix is successfully filled.
 	 **/
-bool random_matrix(Matrix_t* m, unsigned int start_range, unsigned int end_range) {
+bool random_matrix(FILE* out, Matrix_t* m, unsigned int start_range, unsigned int end_range) {
 	
 	//Check if m is null
 	if(!m){
-		printf("\nInput matrix null\n");
+		fprintf(out, "\nInput matrix null\n");
 		return false;
 	}
 	//Check if start_range is larger than end_range
 	if(start_range > end_range){
-		printf("\nError starting range cannot be greater than end_range");
+		fprintf(out, "\nError starting range cannot be greater than end_range\n");
 		return false;
 	}
 
-	for (unsigned int i = 0; i < m->rows; ++i) {
-		for (unsigned int j = 0; j < m->cols; ++j) {
-			m->data[i * m->cols + j] = rand() % (end_range + 1 - start_range) + start_range;
+	for (size_t i = 0; i < m->rows; ++i) {
+		for (size_t j = 0; j < m->cols; ++j) {
+			m->data[i * m->stride + j] = rand() % (end_range + 1 - start_range) + start_range;
 		}
 	}
 	return true;
 }
 
-/*Protected Functions in C*/
+	/* 
+	 * PURPOSE: Transposes src into dest, dest must already be sized cols x rows.
+	 * 			The matrix is split recursively along its longer side until the
+	 * 			pieces fit in a cache tile, so it performs well without knowing
+	 * 			the cache sizes of the machine.
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   src : matrix to transpose
+	 * 		   dest : matrix to hold the transpose of src
+	 * RETURN: True if the transpose was stored in dest. False if either matrix is
+	 * 		   null, they are the same matrix or dest has the wrong dimensions.
+	 **/
+bool transpose_matrix (FILE* out, Matrix_t* src, Matrix_t* dest) {
+
+	if (!src || !dest) {
+		fprintf(out, "\nCheck inputs a matrix pointer may be null.\n");
+		return false;
+	}
+	if (src == dest) {
+		fprintf(out, "\nUse transpose_matrix_in_place to transpose a matrix onto itself\n");
+		return false;
+	}
+	if (src->rows != dest->cols || src->cols != dest->rows) {
+		fprintf(out, "\nIncompatible matrix sizes:\nSource is: %zu X %zu\nDestination is: %zu X %zu\n",
+				src->rows,src->cols,dest->rows,dest->cols);
+		return false;
+	}
+
+	transpose_recursive(src->data, src->stride, dest->data, dest->stride,
+			0, src->rows, 0, src->cols);
+	return true;
+}
 
 	/* 
-	 * PURPOSE: Loads matrix with ints from data[] 
+	 * PURPOSE: Transposes a square matrix without allocating a second buffer.
+	 * 			Tiles above the diagonal are swapped with their mirror tile
+	 * 			below it, tiles on the diagonal are transposed in place.
 	 * INPUTS: 
-	 * 		   m : pointer to matrix to fill
-	 * 		   data : pointer to list of data to fill matrix with
-	 * RETURN: void
+	 * 		   out : stream diagnostics are printed to
+	 * 		   m : square matrix to transpose
+	 * RETURN: True if m was transposed. False if m is null or not square.
 	 **/
-void load_matrix (Matrix_t* m, unsigned int* data) {
-	
-	if(!m){
-		printf("\nMatrix null.\n");
-		return;
+bool transpose_matrix_in_place (FILE* out, Matrix_t* m) {
+
+	if (!m) {
+		fprintf(out, "\nInput matrix is null\n");
+		return false;
 	}
-	
-	memcpy(m->data,data,m->rows * m->cols * sizeof(unsigned int));
+	if (m->rows != m->cols) {
+		fprintf(out, "\nIn place transpose requires a square matrix, %s is %zu X %zu\n",
+				m->name, m->rows, m->cols);
+		return false;
+	}
+
+	const size_t n = m->rows;
+	for (size_t bi = 0; bi < n; bi += TRANSPOSE_TILE) {
+		const size_t bi_end = bi + TRANSPOSE_TILE < n ? bi + TRANSPOSE_TILE : n;
+		for (size_t bj = bi; bj < n; bj += TRANSPOSE_TILE) {
+			const size_t bj_end = bj + TRANSPOSE_TILE < n ? bj + TRANSPOSE_TILE : n;
+			transpose_swap_tiles(m->data, m->stride, bi, bi_end, bj, bj_end);
+		}
+	}
+	return true;
 }
 
 	/* 
-	 * PURPOSE: Adds a matrix to the array of matrices (Matrix_t** mats) 
+	 * PURPOSE: Computes the sum, min, max and element count of every row of a.
+	 * 			Rows are split into bands that are reduced in parallel.
 	 * INPUTS: 
-	 * 		   mats : pointer to array of matrices
-	 * 		   new_matrix : pointer to matrix to be added
-	 * 		   num_mats : number of matrices in array
-	 * 
-	 * RETURN: index of matrix that was added to the array.
+	 * 		   out : stream diagnostics are printed to
+	 * 		   a : matrix to reduce
+	 * 		   result : array of a->rows reductions, filled in row order
+	 * RETURN: True if result was filled. False if an input is null or the
+	 * 		   worker threads could not be started.
 	 **/
-unsigned int add_matrix_to_array (Matrix_t** mats, Matrix_t* new_matrix, unsigned int num_mats) {
-	
-	if(!new_matrix){
-		perror("New matrix is null\n");
-		return (num_mats+1);
+bool reduce_rows (FILE* out, Matrix_t* a, Reduction_t* result) {
+
+	if (!a || !result) {
+		fprintf(out, "\nCheck inputs, a matrix or the result is null\n");
+		return false;
 	}
-	static long int current_position = 0;
-	const long int pos = current_position % num_mats;
-	if ( mats[pos] ) {
-		destroy_matrix(&mats[pos]);
-	} 
-	mats[pos] = new_matrix;
-	current_position++;
-	return pos;
+
+	Reduce_Args_t args = { .m = a, .result = result };
+	return parallel_rows(out, row_thread_count(a->rows, a->cols), a->rows, reduce_rows_kernel, &args);
+}
+
+	/* 
+	 * PURPOSE: Computes the sum, min, max and element count of every column of a.
+	 * 			Each worker walks its band of rows front to back, folding every
+	 * 			row into private per-column accumulators, so columns are never
+	 * 			read with a stride. The private accumulators are merged in worker
+	 * 			order afterwards. Sums are exact 64-bit integers, so the result
+	 * 			does not depend on how many workers were used.
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   a : matrix to reduce
+	 * 		   result : array of a->cols reductions, filled in column order
+	 * RETURN: True if result was filled. False if an input is null or memory for
+	 * 		   the accumulators or worker threads could not be obtained.
+	 **/
+bool reduce_cols (FILE* out, Matrix_t* a, Reduction_t* result) {
+
+	if (!a || !result) {
+		fprintf(out, "\nCheck inputs, a matrix or the result is null\n");
+		return false;
+	}
+
+	const unsigned int threads = row_thread_count(a->rows, a->cols);
+	const size_t per_line = CACHE_LINE_SIZE / sizeof(unsigned int);
+	Reduce_Args_t args = { .m = a, .result = result };
+	args.padded_cols = (a->cols + per_line - 1) / per_line * per_line;
+	const size_t slots = threads * (args.padded_cols ? args.padded_cols : per_line);
+	args.sums = aligned_alloc(CACHE_LINE_SIZE, slots * sizeof(unsigned long long));
+	args.mins = aligned_alloc(CACHE_LINE_SIZE, slots * sizeof(unsigned int));
+	args.maxs = aligned_alloc(CACHE_LINE_SIZE, slots * sizeof(unsigned int));
+	if (!args.sums || !args.mins || !args.maxs) {
+		free(args.sums);
+		free(args.mins);
+		free(args.maxs);
+		fprintf(out, "Failed to allocate column accumulators: %s\n", strerror(errno));
+		return false;
+	}
+
+	bool ok = parallel_rows(out, threads, a->rows, reduce_cols_kernel, &args);
+	for (size_t j = 0; ok && j < a->cols; ++j) {
+		Reduction_t r = { .sum = 0, .min = UINT_MAX, .max = 0, .count = a->rows };
+		for (unsigned int t = 0; t < threads; ++t) {
+			const size_t at = t * args.padded_cols + j;
+			r.sum += args.sums[at];
+			r.min = args.mins[at] < r.min ? args.mins[at] : r.min;
+			r.max = args.maxs[at] > r.max ? args.maxs[at] : r.max;
+		}
+		r.min = a->rows ? r.min : 0;
+		result[j] = r;
+	}
+	free(args.sums);
+	free(args.mins);
+	free(args.maxs);
+	return ok;
+}
+
+	/* 
+	 * PURPOSE: Stores the reductions of a into the matrix r, one reduction per
+	 * 			row (by_row) or per column. Each reduction is laid out as the
+	 * 			four values sum, min, max, count along a row of r for row
+	 * 			reductions and down a column of r for column reductions. Sums
+	 * 			and counts that do not fit in an unsigned int are clamped to
+	 * 			UINT_MAX.
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   a : matrix to reduce
+	 * 		   r : result matrix, a->rows x 4 for rows or 4 x a->cols for columns
+	 * 		   by_row : true to reduce rows, false to reduce columns
+	 * RETURN: True if r was filled. False on null input, wrong result size or
+	 * 		   failure of the reduction.
+	 **/
+bool reduction_matrix (FILE* out, Matrix_t* a, Matrix_t* r, bool by_row) {
+
+	if (!a || !r) {
+		fprintf(out, "\nCheck inputs a matrix pointer may be null.\n");
+		return false;
+	}
+	const size_t n = by_row ? a->rows : a->cols;
+	if ((by_row && (r->rows != n || r->cols != 4))
+		|| (!by_row && (r->rows != 4 || r->cols != n))) {
+		fprintf(out, "\nResult matrix %s must be %zu X %zu\n", r->name,
+				by_row ? n : (size_t) 4, by_row ? (size_t) 4 : n);
+		return false;
+	}
+
+	Reduction_t* red = calloc(n, sizeof(Reduction_t));
+	if (!red && n > 0) {
+		fprintf(out, "Failed to allocate reductions: %s\n", strerror(errno));
+		return false;
+	}
+	if (!(by_row ? reduce_rows(out, a, red) : reduce_cols(out, a, red))) {
+		free(red);
+		return false;
+	}
+
+	size_t clamped = 0;
+	for (size_t k = 0; k < n; ++k) {
+		unsigned int values[4];
+		values[0] = red[k].sum > UINT_MAX ? UINT_MAX : (unsigned int) red[k].sum;
+		values[1] = red[k].min;
+		values[2] = red[k].max;
+		values[3] = red[k].count > UINT_MAX ? UINT_MAX : (unsigned int) red[k].count;
+		clamped += red[k].sum > UINT_MAX || red[k].count > UINT_MAX;
+		for (unsigned int v = 0; v < 4; ++v) {
+			if (by_row) {
+				r->data[k * r->stride + v] = values[v];
+			}
+			else {
+				r->data[v * r->stride + k] = values[v];
+			}
+		}
+	}
+	if (clamped) {
+		fprintf(out, "\n%zu sums or counts of %s did not fit in an unsigned int and were clamped\n",
+				clamped, a->name);
+	}
+	free(red);
+	return true;
+}
+
+	/* 
+	 * PURPOSE: Adds up every element of the matrix
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   m : matrix to sum
+	 * RETURN: The 64-bit total of all the elements, 0 if m is null.
+	 **/
+unsigned long long sum_matrix (FILE* out, Matrix_t* m) {
+
+	if (!m) {
+		fprintf(out, "\nInput matrix is null\n");
+		return 0;
+	}
+	if (m->rows == 0 || m->cols == 0) {
+		return 0;
+	}
+
+	Reduction_t* rows = calloc(m->rows, sizeof(Reduction_t));
+	if (!rows) {
+		fprintf(out, "Failed to allocate row accumulators: %s\n", strerror(errno));
+		return 0;
+	}
+	unsigned long long total = 0;
+	if (reduce_rows(out, m, rows)) {
+		for (size_t i = 0; i < m->rows; ++i) {
+			total += rows[i].sum;
+		}
+	}
+	free(rows);
+	return total;
+}
+
+	/* 
+	 * PURPOSE: Convolves src with a small kernel into dest. Each element of dest is
+	 * 			the sum of the kernel's weights times the elements of src under
+	 * 			them, with the kernel centred on the element (the centre of an
+	 * 			even sized kernel is the element after its middle). The kernel is
+	 * 			not flipped. Sums are kept in 64 bits and clamped to UINT_MAX
+	 * 			when stored.
+	 * 			Box kernels are summed from a summed-area table, kernels that are
+	 * 			the product of a column and a row are applied as two 1D passes,
+	 * 			any other kernel directly. Rows are split across threads.
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   src : matrix to convolve
+	 * 		   kernel : the weights
+	 * 		   dest : result, the size of src, sharing no elements with src or kernel
+	 * 		   boundary : what is read past the edges of src
+	 * RETURN: True if dest was filled. False on bad sizes, a kernel whose weights
+	 * 		   sum past 2^32 or a failed allocation.
+	 **/
+bool convolve_matrix (FILE* out, Matrix_t* src, Matrix_t* kernel, Matrix_t* dest, Boundary_t boundary) {
+
+	if (!src || !kernel || !dest) {
+		fprintf(out, "\nCheck inputs a matrix pointer may be null.\n");
+		return false;
+	}
+	if (dest->rows != src->rows || dest->cols != src->cols) {
+		fprintf(out, "\nResult matrix %s must be %zu X %zu\n", dest->name, src->rows, src->cols);
+		return false;
+	}
+	if (kernel->rows == 0 || kernel->cols == 0) {
+		fprintf(out, "\nKernel %s is empty\n", kernel->name);
+		return false;
+	}
+	if (blocks_overlap(dest, src) || blocks_overlap(dest, kernel)) {
+		fprintf(out, "\nResult matrix %s overlaps an operand\n", dest->name);
+		return false;
+	}
+	if (src->rows == 0 || src->cols == 0) {
+		return true;
+	}
+
+	/*
+	 * Every sum is at most the sum of the weights times UINT_MAX. Keeping that
+	 * within 64 bits means no accumulator can overflow whatever the data.
+	 */
+	const size_t kh = kernel->rows;
+	const size_t kw = kernel->cols;
+	unsigned long long weight_sum = 0;
+	bool box = true;
+	for (size_t u = 0; u < kh; ++u) {
+		for (size_t v = 0; v < kw; ++v) {
+			const unsigned int w = kernel->data[u * kernel->stride + v];
+			box = box && w == kernel->data[0];
+			if (__builtin_add_overflow(weight_sum, w, &weight_sum)) {
+				weight_sum = ULLONG_MAX;
+			}
+		}
+	}
+	unsigned long long bound = 0;
+	if (__builtin_mul_overflow(weight_sum, (unsigned long long) UINT_MAX, &bound)) {
+		fprintf(out, "\nThe weights of kernel %s sum to more than 2^32\n", kernel->name);
+		return false;
+	}
+
+	Conv_Args_t args = { .src = src, .kernel = kernel, .dest = dest, .boundary = boundary };
+	args.padded_cols = (src->cols + CONV_TILE - 1) / CONV_TILE * CONV_TILE;
+	Row_Kernel_t conv = conv_direct_kernel;
+
+	/* the table sums a chunk's worth of padded source, which must fit in 64 bits too */
+	unsigned long long table_bound = 0;
+	if (box && kh * kw >= CONV_BOX_MIN_TAPS
+		&& !__builtin_mul_overflow((unsigned long long) (CONV_SAT_ROWS + kh) * (src->cols + kw),
+				(unsigned long long) UINT_MAX, &table_bound)) {
+		args.box_weight = kernel->data[0];
+		conv = conv_box_kernel;
+	}
+	else if (kh > 1 && kw > 1) {
+		args.row_weights = calloc(kw, sizeof(unsigned int));
+		args.col_weights = calloc(kh, sizeof(unsigned int));
+		if (!args.row_weights || !args.col_weights) {
+			free(args.row_weights);
+			free(args.col_weights);
+			fprintf(out, "Failed to allocate kernel weights: %s\n", strerror(errno));
+			return false;
+		}
+		if (separable_weights(kernel, args.row_weights, args.col_weights)) {
+			conv = conv_separable_kernel;
+		}
+	}
+
+	bool ok = parallel_rows(out, row_thread_count(src->rows, src->cols), src->rows, conv, &args);
+	free(args.row_weights);
+	free(args.col_weights);
+	if (!ok) {
+		return false;
+	}
+	if (args.failed) {
+		fprintf(out, "Failed to allocate convolution buffers: %s\n", strerror(errno));
+		return false;
+	}
+	if (args.clamped) {
+		fprintf(out, "\n%zu results of convolving %s did not fit in an unsigned int and were clamped\n",
+				args.clamped, src->name);
+	}
+	return true;
+}
+
+	/* 
+	 * PURPOSE: Counts the elements of m in equal width bins spanning its smallest
+	 * 			to its largest element. Each worker counts its rows into private
+	 * 			bins, which are added up at the end.
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   m : matrix to count
+	 * 		   bins : how many bins to use, 1 to HIST_MAX_BINS. Fewer are used when
+	 * 		   		  m spans fewer values.
+	 * 		   hist : receives the bins' range and width
+	 * 		   counts : receives hist->bins counts, room for bins
+	 * RETURN: True if counts were filled, false on bad inputs or a failed allocation
+	 **/
+bool histogram_matrix (FILE* out, Matrix_t* m, unsigned int bins, Histogram_t* hist, unsigned long long* counts) {
+
+	if (!m || !hist || !counts) {
+		fprintf(out, "\nCheck inputs, the matrix or the results are null\n");
+		return false;
+	}
+	if (bins == 0 || bins > HIST_MAX_BINS) {
+		fprintf(out, "\nA histogram has 1 to %u bins\n", HIST_MAX_BINS);
+		return false;
+	}
+	memset(hist, 0, sizeof(Histogram_t));
+	if (m->rows == 0 || m->cols == 0) {
+		return true;
+	}
+	if (!matrix_extent(out, m, &hist->min, &hist->max)) {
+		return false;
+	}
+
+	const unsigned long long range = (unsigned long long) hist->max - hist->min + 1;
+	hist->width = (range + bins - 1) / bins;
+	hist->bins = (range + hist->width - 1) / hist->width;
+
+	const unsigned int threads = row_thread_count(m->rows, m->cols);
+	const size_t per_line = CACHE_LINE_SIZE / sizeof(unsigned long long);
+	Histogram_Args_t args = { .m = m, .min = hist->min, .direct = hist->width == 1 };
+	args.stride = (hist->bins + per_line - 1) / per_line * per_line;
+	args.magic = hist->width > UINT_MAX ? 0 : ULLONG_MAX / hist->width + 1;
+	args.partial = aligned_alloc(CACHE_LINE_SIZE, threads * args.stride * sizeof(unsigned long long));
+	if (!args.partial) {
+		fprintf(out, "Failed to allocate histogram bins: %s\n", strerror(errno));
+		return false;
+	}
+	memset(args.partial, 0, threads * args.stride * sizeof(unsigned long long));
+	if (!parallel_rows(out, threads, m->rows, histogram_kernel, &args)) {
+		free(args.partial);
+		return false;
+	}
+
+	memcpy(counts, args.partial, hist->bins * sizeof(unsigned long long));
+	for (unsigned int t = 1; t < threads; ++t) {
+		const unsigned long long* part = &args.partial[t * args.stride];
+		for (unsigned int b = 0; b < hist->bins; ++b) {
+			counts[b] += part[b];
+		}
+	}
+	free(args.partial);
+	return true;
+}
+
+	/* 
+	 * PURPOSE: Counts the different values among the elements of m. Matrices
+	 * 			spanning few values are counted with a bitmap per worker, others
+	 * 			by sorting a copy of the elements.
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   m : matrix to count
+	 * 		   distinct : receives the count
+	 * RETURN: True if the count was made, false on bad inputs or a failed allocation
+	 **/
+bool distinct_values (FILE* out, Matrix_t* m, unsigned long long* distinct) {
+
+	if (!m || !distinct) {
+		fprintf(out, "\nCheck inputs, the matrix or the result is null\n");
+		return false;
+	}
+	*distinct = 0;
+	const size_t n = m->rows * m->cols;
+	if (n == 0) {
+		return true;
+	}
+	unsigned int min = 0, max = 0;
+	if (!matrix_extent(out, m, &min, &max)) {
+		return false;
+	}
+
+	const unsigned long long range = (unsigned long long) max - min + 1;
+	if (range <= DISTINCT_BITMAP_RANGE && range <= (unsigned long long) n * DISTINCT_BITMAP_PER_ELEMENT) {
+		const unsigned int threads = row_thread_count(m->rows, m->cols);
+		const size_t per_line = CACHE_LINE_SIZE / sizeof(unsigned long long);
+		Distinct_Args_t args = { .m = m, .min = min };
+		args.words = ((range + 63) / 64 + per_line - 1) / per_line * per_line;
+		args.bitmaps = aligned_alloc(CACHE_LINE_SIZE, threads * args.words * sizeof(unsigned long long));
+		if (!args.bitmaps) {
+			fprintf(out, "Failed to allocate distinct bitmaps: %s\n", strerror(errno));
+			return false;
+		}
+		memset(args.bitmaps, 0, threads * args.words * sizeof(unsigned long long));
+		if (!parallel_rows(out, threads, m->rows, distinct_kernel, &args)) {
+			free(args.bitmaps);
+			return false;
+		}
+		for (size_t w = 0; w < args.words; ++w) {
+			unsigned long long bits = 0;
+			for (unsigned int t = 0; t < threads; ++t) {
+				bits |= args.bitmaps[t * args.words + w];
+			}
+			*distinct += __builtin_popcountll(bits);
+		}
+		free(args.bitmaps);
+		return true;
+	}
+
+	unsigned int* sorted = malloc(n * sizeof(unsigned int));
+	if (!sorted) {
+		fprintf(out, "Failed to allocate sorted elements: %s\n", strerror(errno));
+		return false;
+	}
+	if (!radix_sort_matrix(out, m, sorted)) {
+		free(sorted);
+		return false;
+	}
+	*distinct = 1;
+	for (size_t k = 1; k < n; ++k) {
+		*distinct += sorted[k] != sorted[k - 1];
+	}
+	free(sorted);
+	return true;
+}
+
+	/* 
+	 * PURPOSE: Sorts the elements of m in place, smallest first, either each row
+	 * 			on its own or the whole matrix in row order. Rows are radix sorted
+	 * 			in parallel, a whole matrix by the parallel radix sort distinct uses.
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   m : matrix to sort
+	 * 		   by_row : sort each row rather than the whole matrix
+	 * RETURN: True if m was sorted, false on a null matrix or a failed allocation
+	 **/
+bool sort_matrix (FILE* out, Matrix_t* m, bool by_row) {
+
+	if (!m) {
+		fprintf(out, "\nInput matrix is null\n");
+		return false;
+	}
+	const size_t n = m->rows * m->cols;
+	if (n == 0) {
+		return true;
+	}
+	if (by_row) {
+		Order_Args_t args = { .m = m };
+		if (!parallel_rows(out, row_thread_count(m->rows, m->cols), m->rows, sort_rows_kernel, &args)) {
+			return false;
+		}
+		if (args.failed) {
+			fprintf(out, "Failed to allocate sort buffers: %s\n", strerror(errno));
+			return false;
+		}
+		return true;
+	}
+
+	unsigned int* sorted = malloc(n * sizeof(unsigned int));
+	if (!sorted) {
+		fprintf(out, "Failed to allocate sorted elements: %s\n", strerror(errno));
+		return false;
+	}
+	if (!radix_sort_matrix(out, m, sorted)) {
+		free(sorted);
+		return false;
+	}
+	for (size_t i = 0; i < m->rows; ++i) {
+		memcpy(&m->data[i * m->stride], &sorted[i * m->cols], m->cols * sizeof(unsigned int));
+	}
+	free(sorted);
+	return true;
+}
+
+	/* 
+	 * PURPOSE: Stores the k largest elements of each row of m, largest first, in
+	 * 			the same row of dest. Rows are split across threads, and each row
+	 * 			is partially selected rather than sorted.
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   m : matrix to select from
+	 * 		   k : elements to keep from each row, 1 to m->cols
+	 * 		   dest : result, m->rows x k, sharing no elements with m
+	 * RETURN: True if dest was filled, false on bad sizes or a failed allocation
+	 **/
+bool top_k_matrix (FILE* out, Matrix_t* m, size_t k, Matrix_t* dest) {
+
+	if (!m || !dest) {
+		fprintf(out, "\nCheck inputs a matrix pointer may be null.\n");
+		return false;
+	}
+	if (k == 0 || k > m->cols) {
+		fprintf(out, "\nk must be between 1 and the %zu columns of %s\n", m->cols, m->name);
+		return false;
+	}
+	if (dest->rows != m->rows || dest->cols != k) {
+		fprintf(out, "\nResult matrix %s must be %zu X %zu\n", dest->name, m->rows, k);
+		return false;
+	}
+	if (blocks_overlap(dest, m)) {
+		fprintf(out, "\nResult matrix %s overlaps %s\n", dest->name, m->name);
+		return false;
+	}
+	Order_Args_t args = { .m = m, .dest = dest, .k = k };
+	if (!parallel_rows(out, row_thread_count(m->rows, m->cols), m->rows, top_k_kernel, &args)) {
+		return false;
+	}
+	if (args.failed) {
+		fprintf(out, "Failed to allocate row buffers: %s\n", strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+	/* 
+	 * PURPOSE: Finds the element of m at a rank, the value that would be at that
+	 * 			position if every element were sorted, without sorting them. The
+	 * 			top bytes of the elements are counted in parallel to find which
+	 * 			of RADIX_BUCKETS value ranges holds the rank, then only that
+	 * 			range's elements are copied out and selected from.
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   m : matrix to look in
+	 * 		   rank : position from the smallest, below rows * cols
+	 * 		   value : receives the element
+	 * RETURN: True if the element was found, false on bad inputs or a failed allocation
+	 **/
+bool rank_value (FILE* out, Matrix_t* m, size_t rank, unsigned int* value) {
+
+	if (!m || !value) {
+		fprintf(out, "\nCheck inputs, the matrix or the result is null\n");
+		return false;
+	}
+	if (rank >= m->rows * m->cols) {
+		fprintf(out, "\nRank %zu is past the %zu elements of %s\n", rank, m->rows * m->cols, m->name);
+		return false;
+	}
+
+	const unsigned int threads = row_thread_count(m->rows, m->cols);
+	Radix_Args_t args = { .m = m };
+	args.counts = calloc((size_t) threads * RADIX_BUCKETS, sizeof(size_t));
+	if (!args.counts) {
+		fprintf(out, "Failed to allocate bucket counts: %s\n", strerror(errno));
+		return false;
+	}
+	if (!parallel_rows(out, threads, m->rows, radix_count_kernel, &args)) {
+		free(args.counts);
+		return false;
+	}
+	unsigned int bucket = 0;
+	size_t size = 0;
+	for (;; ++bucket) {
+		size = 0;
+		for (unsigned int t = 0; t < threads; ++t) {
+			size += args.counts[t * RADIX_BUCKETS + bucket];
+		}
+		if (rank < size) {
+			break;
+		}
+		rank -= size;
+	}
+	free(args.counts);
+
+	/* one spare slot, elements outside the bucket are written past the last one kept */
+	unsigned int* values = malloc((size + 1) * sizeof(unsigned int));
+	if (!values) {
+		fprintf(out, "Failed to allocate selected elements: %s\n", strerror(errno));
+		return false;
+	}
+	size_t at = 0;
+	for (size_t i = 0; i < m->rows; ++i) {
+		const unsigned int* row = &m->data[i * m->stride];
+		for (size_t j = 0; j < m->cols; ++j) {
+			values[at] = row[j];
+			at += row[j] >> (32 - RADIX_BITS) == bucket;
+		}
+	}
+	select_rank(values, size, rank);
+	*value = values[rank];
+	free(values);
+	return true;
+}
+
+	/* 
+	 * PURPOSE: Writes every matrix in the array into one archive file. The archive
+	 * 			is written next to filename and renamed over it at the end, so a
+	 * 			workspace that is currently mapped from filename stays valid.
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   filename : archive to create or replace
+	 * 		   mats : pointer to array of matrices
+	 * 		   num_mats : number of matrices in array
+	 * RETURN: True if the archive was written. False if it could not be.
+	 **/
+bool save_workspace (FILE* out, const char* filename, Matrix_t** mats, unsigned int num_mats) {
+
+	if (!filename || !mats) {
+		fprintf(out, "\nWorkspace file name or matrix array is null\n");
+		return false;
+	}
+
+	Workspace_Header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, WORKSPACE_MAGIC, sizeof(header.magic));
+	header.version = 1;
+	/* spilled matrices are part of the workspace too */
+	const unsigned int capacity = num_mats + num_spilled;
+	Workspace_Entry_t* index = calloc(capacity, sizeof(Workspace_Entry_t));
+	if (!index) {
+		fprintf(out, "Failed to allocate workspace index: %s\n", strerror(errno));
+		return false;
+	}
+
+	unsigned long long offset = sizeof(header) + (unsigned long long) capacity * sizeof(Workspace_Entry_t);
+	for (unsigned int i = 0; i < capacity; ++i) {
+		if (i >= num_mats) {
+			const Spilled_Matrix_t* sp = &spilled[i - num_mats];
+			Workspace_Entry_t* e = &index[header.count++];
+			memcpy(e->name, sp->name, MATRIX_NAME_LEN);
+			e->rows = sp->rows;
+			e->cols = sp->cols;
+			e->bytes = sp->bytes;
+			offset = (offset + WORKSPACE_ALIGN - 1) / WORKSPACE_ALIGN * WORKSPACE_ALIGN;
+			e->offset = offset;
+			offset += e->bytes;
+			continue;
+		}
+		if (!mats[i]) {
+			continue;
+		}
+		Workspace_Entry_t* e = &index[header.count++];
+		memcpy(e->name, mats[i]->name, MATRIX_NAME_LEN);
+		e->rows = mats[i]->rows;
+		e->cols = mats[i]->cols;
+		e->bytes = matrix_bytes(mats[i]);
+		offset = (offset + WORKSPACE_ALIGN - 1) / WORKSPACE_ALIGN * WORKSPACE_ALIGN;
+		e->offset = offset;
+		offset += e->bytes;
+	}
+
+	char tmp_name[strlen(filename) + sizeof(".tmp")];
+	sprintf(tmp_name, "%s.tmp", filename);
+	int fd = open(tmp_name, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(out, "FAILED TO CREATE/OPEN WORKSPACE FOR WRITING: %s\n", strerror(errno));
+		free(index);
+		return false;
+	}
+
+	bool ok = write_fully(fd, &header, sizeof(header), 0)
+		&& write_fully(fd, index, capacity * sizeof(Workspace_Entry_t), sizeof(header));
+	for (unsigned int i = 0, k = 0; ok && i < capacity; ++i) {
+		if (i < num_mats && !mats[i]) {
+			continue;
+		}
+		const Workspace_Entry_t* e = &index[k++];
+		if (i >= num_mats) {
+			ok = copy_spilled_matrix(i - num_mats, NULL, NULL, NULL, fd, e->offset);
+		}
+		else {
+			ok = write_rows(fd, mats[i], e->offset);
+		}
+	}
+	/* a trailing empty matrix still needs the file to reach its offset */
+	ok = ok && ftruncate(fd, offset) == 0;
+	free(index);
+
+	if (!ok) {
+		fprintf(out, "FAILED TO WRITE WORKSPACE: %s\n", strerror(errno));
+		close(fd);
+		unlink(tmp_name);
+		return false;
+	}
+	if (close(fd) || rename(tmp_name, filename)) {
+		fprintf(out, "FAILED TO REPLACE WORKSPACE: %s\n", strerror(errno));
+		unlink(tmp_name);
+		return false;
+	}
+	return true;
+}
+
+	/* 
+	 * PURPOSE: Registers every matrix in a workspace archive. Each matrix is mapped
+	 * 			privately from the file, so loading only reads the index and a matrix
+	 * 			is paged in when first used. Changes are never written back to the
+	 * 			archive, use save_workspace for that.
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   filename : archive written by save_workspace
+	 * 		   mats : pointer to array of matrices
+	 * 		   num_mats : number of matrices in array
+	 * RETURN: True if every matrix in the archive was registered. False if the
+	 * 		   archive is unreadable or malformed.
+	 **/
+bool load_workspace (FILE* out, const char* filename, Matrix_t** mats, unsigned int num_mats) {
+
+	if (!filename || !mats) {
+		fprintf(out, "\nWorkspace file name or matrix array is null\n");
+		return false;
+	}
+
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		fprintf(out, "FAILED TO OPEN WORKSPACE FOR READING: %s\n", strerror(errno));
+		return false;
+	}
+	struct stat st;
+	Workspace_Header_t header;
+	if (fstat(fd, &st) || !read_fully(fd, &header, sizeof(header), 0)
+		|| memcmp(header.magic, WORKSPACE_MAGIC, sizeof(header.magic)) || header.version != 1) {
+		fprintf(out, "%s is not a workspace archive\n", filename);
+		close(fd);
+		return false;
+	}
+	if (header.count > num_mats) {
+		fprintf(out, "\nWorkspace holds %u matrices, only %u fit in memory and the rest will be spilled\n",
+				header.count, num_mats);
+	}
+
+	bool ok = true;
+	for (unsigned int i = 0; ok && i < header.count; ++i) {
+		Workspace_Entry_t e;
+		Matrix_t* m = NULL;
+		ok = read_fully(fd, &e, sizeof(e), sizeof(header) + (off_t) i * sizeof(e));
+		if (ok) {
+			e.name[MATRIX_NAME_LEN - 1] = '\0';
+			unsigned long long bytes = 0;
+			ok = !__builtin_mul_overflow(e.rows, e.cols, &bytes)
+				&& !__builtin_mul_overflow(bytes, sizeof(unsigned int), &bytes)
+				&& e.bytes == bytes && bytes <= SIZE_MAX
+				&& e.offset <= (unsigned long long) st.st_size
+				&& e.bytes <= (unsigned long long) st.st_size - e.offset;
+		}
+		if (!ok) {
+			fprintf(out, "\nWorkspace %s has a corrupt index entry %u\n", filename, i);
+			break;
+		}
+		ok = map_matrix(out, &m, e.name, e.rows, e.cols, fd, e.offset);
+		if (ok) {
+			add_matrix_to_array(out, mats, m, num_mats);
+		}
+	}
+
+	close(fd);
+	return ok;
+}
+
+/*Protected Functions in C*/
+
+	/* 
+	 * PURPOSE: Loads matrix with ints from data[] 
+	 * INPUTS: 
+	 * 		   m : pointer to matrix to fill
+	 * 		   data : pointer to list of data to fill matrix with
+	 * RETURN: void
+	 **/
+void load_matrix (Matrix_t* m, unsigned int* data) {
+	
+	if(!m){
+		printf("\nMatrix null.\n");
+		return;
+	}
+	
+	memcpy(m->data,data,matrix_bytes(m));
+}
+
+	/* 
+	 * PURPOSE: Adds a matrix to the array of matrices (Matrix_t** mats). A matrix
+	 * 			already registered under the same name is replaced. Otherwise the
+	 * 			matrix goes in an empty slot, or when there is none in the slot of
+	 * 			the least recently used matrix, which is spilled to disk rather
+	 * 			than lost. Afterwards the memory budget is enforced.
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   mats : pointer to array of matrices
+	 * 		   new_matrix : pointer to matrix to be added
+	 * 		   num_mats : number of matrices in array
+	 * 
+	 * RETURN: index of matrix that was added to the array, num_mats + 1 if it
+	 * 		   could not be added.
+	 **/
+unsigned int add_matrix_to_array (FILE* out, Matrix_t** mats, Matrix_t* new_matrix, unsigned int num_mats) {
+	
+	if(!new_matrix){
+		fprintf(out, "New matrix is null: %s\n", strerror(errno));
+		return (num_mats+1);
+	}
+
+	forget_spilled_matrix(new_matrix->name);
+	unsigned int pos = num_mats;
+	for (unsigned int i = 0; i < num_mats; ++i) {
+		if (mats[i] && strncmp(mats[i]->name, new_matrix->name, MATRIX_NAME_LEN) == 0) {
+			pos = i;
+			break;
+		}
+		if (!mats[i] && pos == num_mats) {
+			pos = i;
+		}
+	}
+	if (pos == num_mats) {
+		pos = least_recently_used(mats, num_mats, new_matrix);
+		if (pos == num_mats) {
+			fprintf(out, "\nEvery matrix is in use by the current command\n");
+			return (num_mats+1);
+		}
+	}
+	if ( mats[pos] && strncmp(mats[pos]->name, new_matrix->name, MATRIX_NAME_LEN) == 0 ) {
+		destroy_matrix(&mats[pos]);
+	}
+	else if ( mats[pos] && !spill_matrix(out, mats, pos) ) {
+		fprintf(out, "\nMatrix %s could not be spilled and was dropped\n", mats[pos]->name);
+		destroy_matrix(&mats[pos]);
+	} 
+	mats[pos] = new_matrix;
+	new_matrix->last_used = __atomic_add_fetch(&lru_clock, 1, __ATOMIC_RELAXED);
+	enforce_budget(out, mats, num_mats, new_matrix);
+	return pos;
+}
+
+	/* 
+	 * PURPOSE: Marks a matrix as the most recently used and pins it, so it is not
+	 * 			spilled before the next call to unpin_matrices.
+	 * INPUTS: 
+	 * 		   m : matrix that was just looked up
+	 * RETURN: void
+	 **/
+void touch_matrix (Matrix_t* m) {
+	if (m) {
+		__atomic_store_n(&m->last_used, __atomic_add_fetch(&lru_clock, 1, __ATOMIC_RELAXED),
+				__ATOMIC_RELAXED);
+		__atomic_store_n(&m->pin_epoch, __atomic_load_n(&pin_epoch, __ATOMIC_RELAXED),
+				__ATOMIC_RELAXED);
+	}
+}
+
+	/* 
+	 * PURPOSE: Releases every pin taken by touch_matrix. Called before each command
+	 * 			so that the matrices it looks up stay in memory while it registers
+	 * 			its result, but no longer than that.
+	 * INPUTS: none
+	 * RETURN: void
+	 **/
+void unpin_matrices (void) {
+	__atomic_add_fetch(&pin_epoch, 1, __ATOMIC_RELAXED);
+}
+
+	/* 
+	 * PURPOSE: Sets how many bytes of matrix data may stay in memory. Least recently
+	 * 			used matrices are spilled to a scratch file beyond that.
+	 * INPUTS: 
+	 * 		   bytes : the budget, 0 for no limit
+	 * RETURN: void
+	 **/
+void set_memory_budget (size_t bytes) {
+	memory_budget = bytes;
+}
+
+	/* 
+	 * PURPOSE: Spills least recently used matrices until the resident data fits in
+	 * 			the memory budget. Pinned matrices are never spilled, so the budget
+	 * 			can be exceeded while a command needs more than it allows.
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   mats : pointer to array of matrices
+	 * 		   num_mats : number of matrices in array
+	 * RETURN: void
+	 **/
+void enforce_memory_budget (FILE* out, Matrix_t** mats, unsigned int num_mats) {
+	enforce_budget(out, mats, num_mats, NULL);
+}
+
+	/* 
+	 * PURPOSE: enforce_memory_budget, never spilling one given matrix
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   mats : pointer to array of matrices
+	 * 		   num_mats : number of matrices in array
+	 * 		   except : matrix to keep in memory, may be null
+	 * RETURN: void
+	 **/
+static void enforce_budget (FILE* out, Matrix_t** mats, unsigned int num_mats, Matrix_t* except) {
+	if (!memory_budget) {
+		return;
+	}
+	size_t resident = 0;
+	for (unsigned int i = 0; i < num_mats; ++i) {
+		resident += mats[i] ? resident_bytes(mats[i]) : 0;
+	}
+	while (resident > memory_budget) {
+		unsigned int victim = least_recently_used(mats, num_mats, except);
+		if (victim == num_mats) {
+			return;
+		}
+		size_t bytes = resident_bytes(mats[victim]);
+		if (!spill_matrix(out, mats, victim)) {
+			return;
+		}
+		resident -= bytes;
+	}
+}
+
+	/* 
+	 * PURPOSE: Writes a matrix's data to the end of the scratch file and removes
+	 * 			the matrix from memory. It comes back on the next lookup by name.
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   mats : pointer to array of matrices
+	 * 		   idx : slot of the matrix to spill, left empty
+	 * RETURN: True if the matrix was spilled. False if the scratch file could not
+	 * 		   be written, the matrix is then left where it was.
+	 **/
+bool spill_matrix (FILE* out, Matrix_t** mats, unsigned int idx) {
+	Matrix_t* m = mats[idx];
+	if (!m) {
+		return false;
+	}
+	if (m->parent || m->views) {
+		fprintf(out, "\nMatrix %s shares its data with a view and cannot be spilled\n", m->name);
+		return false;
+	}
+	if (spill_fd < 0) {
+		const char* dir = getenv("TMPDIR");
+		char path[4096];
+		snprintf(path, sizeof(path), "%s/matlab-spill-XXXXXX", dir ? dir : "/tmp");
+		spill_fd = mkstemp(path);
+		if (spill_fd < 0) {
+			fprintf(out, "FAILED TO CREATE SPILL FILE: %s\n", strerror(errno));
+			return false;
+		}
+		/* nobody else needs the file, it disappears with the process */
+		unlink(path);
+	}
+	if (num_spilled == spilled_cap) {
+		unsigned int cap = spilled_cap ? spilled_cap * 2 : 16;
+		Spilled_Matrix_t* grown = realloc(spilled, cap * sizeof(Spilled_Matrix_t));
+		if (!grown) {
+			fprintf(out, "Failed to grow spill index: %s\n", strerror(errno));
+			return false;
+		}
+		spilled = grown;
+		spilled_cap = cap;
+	}
+
+	Spilled_Matrix_t* e = &spilled[num_spilled];
+	memcpy(e->name, m->name, MATRIX_NAME_LEN);
+	e->rows = m->rows;
+	e->cols = m->cols;
+	e->bytes = matrix_bytes(m);
+	e->offset = spill_end;
+	if (!write_rows(spill_fd, m, e->offset)) {
+		fprintf(out, "FAILED TO WRITE SPILL FILE: %s\n", strerror(errno));
+		return false;
+	}
+	spill_end += e->bytes;
+	spilled_bytes += e->bytes;
+	num_spilled++;
+	destroy_matrix(&mats[idx]);
+	return true;
+}
+
+	/* 
+	 * PURPOSE: Brings a spilled matrix back into memory and registers it again
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   mats : pointer to array of matrices
+	 * 		   num_mats : number of matrices in array
+	 * 		   name : name of the spilled matrix
+	 * RETURN: index of the reloaded matrix, or -1 if no matrix of that name was
+	 * 		   spilled or it could not be read back.
+	 **/
+int reload_spilled_matrix (FILE* out, Matrix_t** mats, unsigned int num_mats, const char* name) {
+	unsigned int k = 0;
+	for (; k < num_spilled; ++k) {
+		if (strncmp(spilled[k].name, name, MATRIX_NAME_LEN) == 0) {
+			break;
+		}
+	}
+	if (k == num_spilled) {
+		return -1;
+	}
+
+	Spilled_Matrix_t e = spilled[k];
+	Matrix_t* m = NULL;
+	if (!create_matrix(out, &m, e.name, e.rows, e.cols)) {
+		fprintf(out, "\nNo memory to reload spilled matrix %s\n", e.name);
+		return -1;
+	}
+	if (!read_fully(spill_fd, m->data, e.bytes, e.offset)) {
+		fprintf(out, "FAILED TO READ SPILL FILE: %s\n", strerror(errno));
+		destroy_matrix(&m);
+		return -1;
+	}
+	unsigned int pos = add_matrix_to_array(out, mats, m, num_mats);
+	if (pos > num_mats) {
+		destroy_matrix(&m);
+		return -1;
+	}
+	return pos;
+}
+
+	/* 
+	 * PURPOSE: Reports where matrix data currently lives
+	 * INPUTS: 
+	 * 		   mats : pointer to array of matrices
+	 * 		   num_mats : number of matrices in array
+	 * 		   usage : filled with the resident and spilled totals
+	 * RETURN: void
+	 **/
+void memory_usage (Matrix_t** mats, unsigned int num_mats, Memory_Usage_t* usage) {
+	memset(usage, 0, sizeof(Memory_Usage_t));
+	for (unsigned int i = 0; i < num_mats; ++i) {
+		if (mats[i]) {
+			usage->resident_bytes += resident_bytes(mats[i]);
+			usage->num_resident++;
+		}
+	}
+	usage->spilled_bytes = spilled_bytes;
+	usage->num_spilled = num_spilled;
+	usage->budget_bytes = memory_budget;
+}
+
+	/* 
+	 * PURPOSE: Number of spilled matrices, for iterating with spilled_matrix
+	 * INPUTS: none
+	 * RETURN: how many matrices are currently spilled
+	 **/
+unsigned int spilled_matrix_count (void) {
+	return num_spilled;
+}
+
+	/* 
+	 * PURPOSE: Tells whether a matrix is spilled, without bringing it back
+	 * INPUTS: 
+	 * 		   name : matrix name
+	 * RETURN: True if a matrix of that name is spilled
+	 **/
+bool is_spilled_matrix (const char* name) {
+	for (unsigned int k = 0; k < num_spilled; ++k) {
+		if (strncmp(spilled[k].name, name, MATRIX_NAME_LEN) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+	/* 
+	 * PURPOSE: Copies the data of the k'th spilled matrix to a file without
+	 * 			bringing it back into the array.
+	 * INPUTS: 
+	 * 		   k : which spilled matrix, below spilled_matrix_count()
+	 * 		   name, rows, cols : receive the matrix's name and dimensions, may be null
+	 * 		   fd : file to copy the data to
+	 * 		   offset : where in fd the data goes
+	 * RETURN: True if the data was copied.
+	 **/
+bool copy_spilled_matrix (unsigned int k, char name[MATRIX_NAME_LEN], size_t* rows,
+						size_t* cols, int fd, off_t offset) {
+	if (k >= num_spilled) {
+		return false;
+	}
+	const Spilled_Matrix_t* e = &spilled[k];
+	if (name) {
+		memcpy(name, e->name, MATRIX_NAME_LEN);
+	}
+	if (rows) {
+		*rows = e->rows;
+	}
+	if (cols) {
+		*cols = e->cols;
+	}
+	if (fd < 0) {
+		return true;
+	}
+	char buf[1 << 16];
+	for (size_t done = 0; done < e->bytes; ) {
+		size_t n = e->bytes - done < sizeof(buf) ? e->bytes - done : sizeof(buf);
+		if (!read_fully(spill_fd, buf, n, e->offset + done)
+			|| !write_fully(fd, buf, n, offset + done)) {
+			return false;
+		}
+		done += n;
+	}
+	return true;
+}
+
+	/* 
+	 * PURPOSE: Drops the spilled copy of a matrix, releasing its scratch space
+	 * INPUTS: 
+	 * 		   name : matrix name
+	 * RETURN: void
+	 **/
+static void forget_spilled_matrix (const char* name) {
+	for (unsigned int k = 0; k < num_spilled; ++k) {
+		if (strncmp(spilled[k].name, name, MATRIX_NAME_LEN) == 0) {
+			if (spilled[k].bytes) {
+				fallocate(spill_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+						spilled[k].offset, spilled[k].bytes);
+			}
+			spilled_bytes -= spilled[k].bytes;
+			spilled[k] = spilled[--num_spilled];
+			break;
+		}
+	}
+	if (num_spilled == 0 && spill_fd >= 0) {
+		/* nothing left in the scratch file, start it over */
+		if (ftruncate(spill_fd, 0) == 0) {
+			spill_end = 0;
+		}
+	}
+}
+
+	/* 
+	 * PURPOSE: Finds the least recently used matrix that may be evicted
+	 * INPUTS: 
+	 * 		   mats : pointer to array of matrices
+	 * 		   num_mats : number of matrices in array
+	 * 		   except : matrix that must not be picked, may be null
+	 * RETURN: its slot, or num_mats if every matrix is pinned or excepted
+	 **/
+static unsigned int least_recently_used (Matrix_t** mats, unsigned int num_mats, Matrix_t* except) {
+	unsigned int victim = num_mats;
+	for (unsigned int i = 0; i < num_mats; ++i) {
+		if (!mats[i] || mats[i] == except || mats[i]->pin_epoch == pin_epoch) {
+			continue;
+		}
+		/* a view frees nothing, and the data of a matrix with views must stay put */
+		if (mats[i]->parent || mats[i]->views) {
+			continue;
+		}
+		if (victim == num_mats || mats[i]->last_used < mats[victim]->last_used) {
+			victim = i;
+		}
+	}
+	return victim;
+}
+
+static size_t matrix_bytes (const Matrix_t* m) {
+	return m->rows * m->cols * sizeof(unsigned int);
+}
+
+/* Bytes of data m keeps in memory, nothing for a view */
+static size_t resident_bytes (const Matrix_t* m) {
+	return m->parent ? 0 : matrix_bytes(m);
+}
+
+/* Whether m's rows follow each other without gaps, true unless m is a narrow view */
+static bool is_contiguous (const Matrix_t* m) {
+	return m->stride == m->cols || m->rows <= 1;
+}
+
+	/*
+	 * PURPOSE: Checks whether two matrices share any elements. Only a matrix and
+	 * 			itself or views of one matrix can.
+	 * INPUTS:
+	 *		   a, b : the matrices
+	 * RETURN: True if their blocks overlap
+	 **/
+static bool blocks_overlap (const Matrix_t* a, const Matrix_t* b) {
+	const Matrix_t* owner_a = a->parent ? a->parent : a;
+	const Matrix_t* owner_b = b->parent ? b->parent : b;
+	if (owner_a != owner_b || a->rows == 0 || a->cols == 0 || b->rows == 0 || b->cols == 0) {
+		return false;
+	}
+	/* both share the owner's stride, so compare the blocks as rectangles */
+	const size_t stride = owner_a->stride;
+	const size_t start_a = a->data - owner_a->data;
+	const size_t start_b = b->data - owner_b->data;
+	const size_t ra = start_a / stride, ca = start_a % stride;
+	const size_t rb = start_b / stride, cb = start_b % stride;
+	return ra < rb + b->rows && rb < ra + a->rows && ca < cb + b->cols && cb < ca + a->cols;
+}
+
+	/*
+	 * PURPOSE: Checks whether two matrices share some elements without being the
+	 * 			same block, so that writing one while reading the other element by
+	 * 			element would read results back
+	 * INPUTS:
+	 *		   a, b : the matrices
+	 * RETURN: True if their blocks overlap but do not coincide
+	 **/
+static bool partly_overlap (const Matrix_t* a, const Matrix_t* b) {
+	if (a->data == b->data && a->rows == b->rows && a->cols == b->cols) {
+		return false;
+	}
+	return blocks_overlap(a, b);
+}
+
+	/*
+	 * PURPOSE: Writes a matrix's elements to a file densely packed, a row at a
+	 * 			time when it is a view
+	 * INPUTS:
+	 *		   fd : file to write to
+	 *		   m : the matrix
+	 *		   offset : where in the file the first element goes
+	 * RETURN: True if every element was written
+	 **/
+static bool write_rows (int fd, const Matrix_t* m, off_t offset) {
+	if (is_contiguous(m)) {
+		return write_fully(fd, m->data, matrix_bytes(m), offset);
+	}
+	const size_t row_bytes = m->cols * sizeof(unsigned int);
+	for (size_t i = 0; i < m->rows; ++i) {
+		if (!write_fully(fd, &m->data[i * m->stride], row_bytes, offset + i * row_bytes)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+	/*
+	 * PURPOSE: Allocates zeroed storage for matrix data, on huge pages when it is large
+	 * INPUTS:
+	 *		   bytes : the number of bytes of data
+	 *		   mapped_bytes : set to the length of the mapping, or 0 if the data is
+	 *		   				  from the heap and must be released with free
+	 * RETURN: The data, or NULL if it could not be allocated
+	 **/
+static unsigned int* allocate_matrix_data (size_t bytes, size_t* mapped_bytes) {
+
+	*mapped_bytes = 0;
+	if (bytes < HUGE_PAGE_SIZE) {
+		size_t len = (bytes + CACHE_LINE_SIZE - 1) & ~((size_t) CACHE_LINE_SIZE - 1);
+		unsigned int* data = aligned_alloc(CACHE_LINE_SIZE, len ? len : CACHE_LINE_SIZE);
+		if (data) {
+			memset(data, 0, len);
+		}
+		return data;
+	}
+	if (bytes > SIZE_MAX - HUGE_PAGE_SIZE) {
+		return NULL;
+	}
+	const size_t len = (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+
+	/* Reserved huge pages are only there if the administrator set some aside */
+	void* data = mmap(NULL, len, PROT_READ | PROT_WRITE,
+						MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (data != MAP_FAILED) {
+		*mapped_bytes = len;
+		return data;
+	}
+
+	/*
+	 * Otherwise over allocate by a huge page, trim the mapping to a huge page
+	 * boundary and ask for transparent huge pages.
+	 */
+	char* raw = mmap(NULL, len + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+						MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (raw == MAP_FAILED) {
+		return NULL;
+	}
+	char* aligned = (char*) (((uintptr_t) raw + HUGE_PAGE_SIZE - 1) & ~(uintptr_t) (HUGE_PAGE_SIZE - 1));
+	if (aligned > raw) {
+		munmap(raw, aligned - raw);
+	}
+	if (aligned + len < raw + len + HUGE_PAGE_SIZE) {
+		munmap(aligned + len, raw + len + HUGE_PAGE_SIZE - (aligned + len));
+	}
+	madvise(aligned, len, MADV_HUGEPAGE);
+	*mapped_bytes = len;
+	return (unsigned int*) aligned;
+}
+
+static bool write_fully (int fd, const void* buf, size_t len, off_t offset) {
+	const char* p = buf;
+	while (len > 0) {
+		ssize_t n = pwrite(fd, p, len, offset);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		p += n;
+		len -= n;
+		offset += n;
+	}
+	return true;
+}
+
+static bool read_fully (int fd, void* buf, size_t len, off_t offset) {
+	char* p = buf;
+	while (len > 0) {
+		ssize_t n = pread(fd, p, len, offset);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		p += n;
+		len -= n;
+		offset += n;
+	}
+	return true;
+}
+
+	/* 
+	 * PURPOSE: Picks how many workers a row parallel kernel over a rows x cols
+	 * 			matrix should use, never more than the online cpus or rows and
+	 * 			never so many that a worker gets less than PARALLEL_MIN_ELEMENTS.
+	 * INPUTS: 
+	 * 		   rows : rows in the matrix
+	 * 		   cols : cols in the matrix
+	 * RETURN: number of workers, at least 1
+	 **/
+static unsigned int row_thread_count (size_t rows, size_t cols) {
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus < 1) {
+		cpus = 1;
+	}
+	size_t threads = (rows * cols) / PARALLEL_MIN_ELEMENTS;
+	if (threads > (size_t) cpus) {
+		threads = cpus;
+	}
+	if (threads > rows) {
+		threads = rows;
+	}
+	return threads ? threads : 1;
+}
+
+typedef struct {
+	Row_Kernel_t kernel;
+	void* arg;
+	unsigned int thread;
+	size_t r0;
+	size_t r1;
+} Row_Band_t;
+
+static void* row_band_main (void* band) {
+	Row_Band_t* b = band;
+	b->kernel(b->arg, b->thread, b->r0, b->r1);
+	return NULL;
+}
+
+	/* 
+	 * PURPOSE: Splits [0,rows) into threads contiguous bands and runs kernel on
+	 * 			each, the first band on the calling thread.
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   threads : number of bands, from row_thread_count
+	 * 		   rows : rows to split
+	 * 		   kernel : function run on each band
+	 * 		   arg : passed through to kernel
+	 * RETURN: True once every band has run. False if a worker could not be
+	 * 		   started, the bands that were started are still joined.
+	 **/
+static bool parallel_rows (FILE* out, unsigned int threads, size_t rows, Row_Kernel_t kernel, void* arg) {
+	if (threads <= 1) {
+		kernel(arg, 0, 0, rows);
+		return true;
+	}
+
+	pthread_t* tids = calloc(threads, sizeof(pthread_t));
+	Row_Band_t* bands = calloc(threads, sizeof(Row_Band_t));
+	if (!tids || !bands) {
+		free(tids);
+		free(bands);
+		fprintf(out, "Failed to allocate worker bands: %s\n", strerror(errno));
+		return false;
+	}
+
+	bool ok = true;
+	unsigned int started = 1;
+	for (unsigned int t = 0; t < threads; ++t) {
+		bands[t].kernel = kernel;
+		bands[t].arg = arg;
+		bands[t].thread = t;
+		bands[t].r0 = rows / threads * t + rows % threads * t / threads;
+		bands[t].r1 = rows / threads * (t + 1) + rows % threads * (t + 1) / threads;
+	}
+	for (; started < threads; ++started) {
+		if (pthread_create(&tids[started], NULL, row_band_main, &bands[started])) {
+			fprintf(out, "Failed to start worker thread: %s\n", strerror(errno));
+			ok = false;
+			break;
+		}
+	}
+	if (ok) {
+		row_band_main(&bands[0]);
+	}
+	for (unsigned int t = 1; t < started; ++t) {
+		pthread_join(tids[t], NULL);
+	}
+	free(tids);
+	free(bands);
+	return ok;
+}
+
+	/* 
+	 * PURPOSE: Folds the reduction b into a
+	 * INPUTS: 
+	 * 		   a : accumulator to update
+	 * 		   b : reduction to fold in
+	 * RETURN: void
+	 **/
+static void merge_reduction (Reduction_t* a, const Reduction_t* b) {
+	if (!b->count) {
+		return;
+	}
+	if (!a->count) {
+		*a = *b;
+		return;
+	}
+	a->sum += b->sum;
+	a->min = b->min < a->min ? b->min : a->min;
+	a->max = b->max > a->max ? b->max : a->max;
+	a->count += b->count;
+}
+
+
+	/* 
+	 * PURPOSE: Checks the result of an element-wise operator and runs its kernel
+	 * 			over row bands of a.
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   op : the operator
+	 * 		   a, b : the operands, b is null for the scalar form
+	 * 		   y, z : the scalars of the scalar form
+	 * 		   c : the result, may be a or b
+	 * RETURN: True if c was filled. False if c is the wrong size.
+	 **/
+static bool elementwise (FILE* out, Elementwise_Op_t op, const Matrix_t* a, const Matrix_t* b,
+						unsigned int y, unsigned int z, Matrix_t* c) {
+	if (c->rows != a->rows || c->cols != a->cols) {
+		fprintf(out, "\nResult matrix %s must be %zu X %zu\n", c->name, a->rows, a->cols);
+		return false;
+	}
+	if (partly_overlap(c, a) || (b && partly_overlap(c, b))) {
+		fprintf(out, "\nResult matrix %s overlaps an operand\n", c->name);
+		return false;
+	}
+	Elementwise_Args_t args = { .a = a, .b = b, .c = c, .y = y, .z = z };
+	return parallel_rows(out, row_thread_count(a->rows, a->cols), a->rows,
+						elementwise_ops[op].kernel, &args);
+}
+
+static inline Lanes_t load_lanes (const unsigned int* p) {
+	Lanes_t v;
+	memcpy(&v, p, sizeof(Lanes_t));
+	return v;
+}
+
+static inline void store_lanes (unsigned int* p, Lanes_t v) {
+	memcpy(p, &v, sizeof(Lanes_t));
+}
+
+/* Lanes of t where mask is all ones, lanes of f where it is zero */
+static inline Lanes_t select_lanes (Lanes_t mask, Lanes_t t, Lanes_t f) {
+	return (t & mask) | (f & ~mask);
+}
+
+/*
+ * Row kernel of one operator. Two vectors of lanes are handled per step so
+ * the loads of the second overlap the arithmetic of the first, then the
+ * leftover columns one at a time. The matrix and scalar forms get separate
+ * loops so the scalar form never reloads its operand.
+ */
+#define ELEMENTWISE_KERNEL(NAME, ENUM, SCALAR, VECTOR) \
+static inline unsigned int elementwise_##NAME (unsigned int x, unsigned int y, unsigned int z) { \
+	return SCALAR; \
+} \
+static inline Lanes_t elementwise_##NAME##_lanes (Lanes_t X, Lanes_t Y, Lanes_t Z) { \
+	return VECTOR; \
+} \
+static void elementwise_##NAME##_kernel (void* arg, unsigned int thread, size_t r0, size_t r1) { \
+	const Elementwise_Args_t* args = arg; \
+	const size_t cols = args->a->cols; \
+	const Lanes_t Y = (Lanes_t) {0} + args->y; \
+	const Lanes_t Z = (Lanes_t) {0} + args->z; \
+	for (size_t i = r0; i < r1; ++i) { \
+		const unsigned int* xs = &args->a->data[i * args->a->stride]; \
+		unsigned int* out = &args->c->data[i * args->c->stride]; \
+		size_t j = 0; \
+		if (args->b) { \
+			const unsigned int* ys = &args->b->data[i * args->b->stride]; \
+			for (; j + 2 * LANES <= cols; j += 2 * LANES) { \
+				Lanes_t v0 = elementwise_##NAME##_lanes(load_lanes(&xs[j]), load_lanes(&ys[j]), Z); \
+				Lanes_t v1 = elementwise_##NAME##_lanes(load_lanes(&xs[j + LANES]), \
+						load_lanes(&ys[j + LANES]), Z); \
+				store_lanes(&out[j], v0); \
+				store_lanes(&out[j + LANES], v1); \
+			} \
+			for (; j < cols; ++j) { \
+				out[j] = elementwise_##NAME(xs[j], ys[j], args->z); \
+			} \
+		} \
+		else { \
+			for (; j + 2 * LANES <= cols; j += 2 * LANES) { \
+				Lanes_t v0 = elementwise_##NAME##_lanes(load_lanes(&xs[j]), Y, Z); \
+				Lanes_t v1 = elementwise_##NAME##_lanes(load_lanes(&xs[j + LANES]), Y, Z); \
+				store_lanes(&out[j], v0); \
+				store_lanes(&out[j + LANES], v1); \
+			} \
+			for (; j < cols; ++j) { \
+				out[j] = elementwise_##NAME(xs[j], args->y, args->z); \
+			} \
+		} \
+	} \
+}
+ELEMENTWISE_OPS(ELEMENTWISE_KERNEL)
+#undef ELEMENTWISE_KERNEL
+
+/* The low and high halves of v widened to 64 bit lanes, for sums that cannot overflow */
+static inline void widen_lanes (Lanes_t v, Wide_Lanes_t* low, Wide_Lanes_t* high) {
+	/* interleave with zeros so each element becomes the low word of a 64 bit lane */
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	*low = (Wide_Lanes_t) __builtin_shuffle(v, (Lanes_t) { 0 }, (Lanes_t) { 0, 4, 1, 5 });
+	*high = (Wide_Lanes_t) __builtin_shuffle(v, (Lanes_t) { 0 }, (Lanes_t) { 2, 6, 3, 7 });
+#else
+	*low = (Wide_Lanes_t) __builtin_shuffle(v, (Lanes_t) { 0 }, (Lanes_t) { 4, 0, 5, 1 });
+	*high = (Wide_Lanes_t) __builtin_shuffle(v, (Lanes_t) { 0 }, (Lanes_t) { 6, 2, 7, 3 });
+#endif
+}
+
+	/* 
+	 * PURPOSE: Reduces each of rows [r0,r1) to its sum, min, max and count. A
+	 * 			vector of lanes is folded in per step, each lane keeping its own
+	 * 			sum, min and max, and the lanes are combined at the end of the row.
+	 * INPUTS: 
+	 * 		   arg : the Reduce_Args_t
+	 * 		   thread : unused
+	 * 		   r0, r1 : rows to reduce
+	 * RETURN: void
+	 **/
+static void reduce_rows_kernel (void* arg, unsigned int thread, size_t r0, size_t r1) {
+	Reduce_Args_t* args = arg;
+	const size_t cols = args->m->cols;
+	const size_t stride = args->m->stride;
+	for (size_t i = r0; i < r1; ++i) {
+		const unsigned int* row = &args->m->data[i * stride];
+		Wide_Lanes_t sum_low = { 0 }, sum_high = { 0 };
+		Lanes_t min = (Lanes_t) { 0 } + UINT_MAX;
+		Lanes_t max = { 0 };
+		size_t j = 0;
+		for (; j + LANES <= cols; j += LANES) {
+			const Lanes_t x = load_lanes(&row[j]);
+			Wide_Lanes_t low, high;
+			widen_lanes(x, &low, &high);
+			sum_low += low;
+			sum_high += high;
+			min = select_lanes((Lanes_t) (x < min), x, min);
+			max = select_lanes((Lanes_t) (x > max), x, max);
+		}
+
+		const Wide_Lanes_t sums = sum_low + sum_high;
+		unsigned long long sum = sums[0] + sums[1];
+		unsigned int lo = UINT_MAX;
+		unsigned int hi = 0;
+		for (unsigned int l = 0; l < LANES; ++l) {
+			lo = min[l] < lo ? min[l] : lo;
+			hi = max[l] > hi ? max[l] : hi;
+		}
+		for (; j < cols; ++j) {
+			sum += row[j];
+			lo = row[j] < lo ? row[j] : lo;
+			hi = row[j] > hi ? row[j] : hi;
+		}
+		args->result[i].sum = sum;
+		args->result[i].min = cols ? lo : 0;
+		args->result[i].max = hi;
+		args->result[i].count = cols;
+	}
+}
+
+	/* 
+	 * PURPOSE: Folds rows [r0,r1) into this worker's column sums, mins and maxes,
+	 * 			a vector of columns at a time
+	 * INPUTS: 
+	 * 		   arg : the Reduce_Args_t
+	 * 		   thread : which accumulators to fold into
+	 * 		   r0, r1 : rows to fold
+	 * RETURN: void
+	 **/
+static void reduce_cols_kernel (void* arg, unsigned int thread, size_t r0, size_t r1) {
+	Reduce_Args_t* args = arg;
+	const size_t cols = args->m->cols;
+	const size_t stride = args->m->stride;
+	unsigned long long* sums = &args->sums[thread * args->padded_cols];
+	unsigned int* mins = &args->mins[thread * args->padded_cols];
+	unsigned int* maxs = &args->maxs[thread * args->padded_cols];
+	for (size_t j = 0; j < cols; ++j) {
+		sums[j] = 0;
+		mins[j] = UINT_MAX;
+		maxs[j] = 0;
+	}
+	for (size_t i = r0; i < r1; ++i) {
+		const unsigned int* row = &args->m->data[i * stride];
+		size_t j = 0;
+		for (; j + LANES <= cols; j += LANES) {
+			const Lanes_t x = load_lanes(&row[j]);
+			const Lanes_t min = load_lanes(&mins[j]);
+			const Lanes_t max = load_lanes(&maxs[j]);
+			Wide_Lanes_t low, high, sum_low, sum_high;
+			widen_lanes(x, &low, &high);
+			memcpy(&sum_low, &sums[j], sizeof(Wide_Lanes_t));
+			memcpy(&sum_high, &sums[j + LANES / 2], sizeof(Wide_Lanes_t));
+			sum_low += low;
+			sum_high += high;
+			memcpy(&sums[j], &sum_low, sizeof(Wide_Lanes_t));
+			memcpy(&sums[j + LANES / 2], &sum_high, sizeof(Wide_Lanes_t));
+			store_lanes(&mins[j], select_lanes((Lanes_t) (x < min), x, min));
+			store_lanes(&maxs[j], select_lanes((Lanes_t) (x > max), x, max));
+		}
+		for (; j < cols; ++j) {
+			sums[j] += row[j];
+			mins[j] = row[j] < mins[j] ? row[j] : mins[j];
+			maxs[j] = row[j] > maxs[j] ? row[j] : maxs[j];
+		}
+	}
+}
+
+	/* 
+	 * PURPOSE: Finds the smallest and largest elements of a matrix, both 0 when
+	 * 			it is empty
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   m : the matrix
+	 * 		   min, max : receive the extremes
+	 * RETURN: True if they were found, false on a failed allocation
+	 **/
+static bool matrix_extent (FILE* out, Matrix_t* m, unsigned int* min, unsigned int* max) {
+	if (m->rows == 0 || m->cols == 0) {
+		*min = 0;
+		*max = 0;
+		return true;
+	}
+	Reduction_t* rows = calloc(m->rows, sizeof(Reduction_t));
+	if (!rows) {
+		fprintf(out, "Failed to allocate row accumulators: %s\n", strerror(errno));
+		return false;
+	}
+	if (!reduce_rows(out, m, rows)) {
+		free(rows);
+		return false;
+	}
+	Reduction_t all = { 0 };
+	for (size_t i = 0; i < m->rows; ++i) {
+		merge_reduction(&all, &rows[i]);
+	}
+	free(rows);
+	*min = all.min;
+	*max = all.max;
+	return true;
+}
+
+	/* 
+	 * PURPOSE: Counts rows [r0,r1) into this worker's bins. A value's bin is
+	 * 			(value - min) / width, the division done as a multiply by the
+	 * 			precomputed inverse of the width (exact for 32 bit values).
+	 * INPUTS: 
+	 * 		   arg : the Histogram_Args_t
+	 * 		   thread : which bins to count into
+	 * 		   r0, r1 : rows to count
+	 * RETURN: void
+	 **/
+static void histogram_kernel (void* arg, unsigned int thread, size_t r0, size_t r1) {
+	Histogram_Args_t* args = arg;
+	const Matrix_t* m = args->m;
+	unsigned long long* counts = &args->partial[thread * args->stride];
+	for (size_t i = r0; i < r1; ++i) {
+		const unsigned int* row = &m->data[i * m->stride];
+		if (args->direct) {
+			for (size_t j = 0; j < m->cols; ++j) {
+				++counts[row[j] - args->min];
+			}
+		}
+		else {
+			for (size_t j = 0; j < m->cols; ++j) {
+				++counts[(unsigned long long) (((unsigned __int128) args->magic * (row[j] - args->min)) >> 64)];
+			}
+		}
+	}
+}
+
+/* Marks the values in rows [r0,r1) in this worker's bitmap */
+static void distinct_kernel (void* arg, unsigned int thread, size_t r0, size_t r1) {
+	Distinct_Args_t* args = arg;
+	const Matrix_t* m = args->m;
+	unsigned long long* bitmap = &args->bitmaps[thread * args->words];
+	for (size_t i = r0; i < r1; ++i) {
+		const unsigned int* row = &m->data[i * m->stride];
+		for (size_t j = 0; j < m->cols; ++j) {
+			const unsigned int v = row[j] - args->min;
+			bitmap[v / 64] |= 1ull << (v % 64);
+		}
+	}
+}
+
+	/* 
+	 * PURPOSE: Sorts every element of m into sorted, smallest first. Each worker
+	 * 			counts the top bytes of its rows, the counts give every worker
+	 * 			its own slots in each bucket to scatter into, then the buckets
+	 * 			are sorted on their remaining bytes independently.
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   m : matrix to sort, unchanged
+	 * 		   sorted : receives rows * cols elements
+	 * RETURN: True if sorted was filled, false on a failed allocation
+	 **/
+static bool radix_sort_matrix (FILE* out, const Matrix_t* m, unsigned int* sorted) {
+	const size_t n = m->rows * m->cols;
+	const unsigned int threads = row_thread_count(m->rows, m->cols);
+	Radix_Args_t args = { .m = m, .out = sorted };
+	args.counts = calloc((size_t) threads * RADIX_BUCKETS, sizeof(size_t));
+	args.scratch = malloc((n ? n : 1) * sizeof(unsigned int));
+	if (!args.counts || !args.scratch) {
+		free(args.counts);
+		free(args.scratch);
+		fprintf(out, "Failed to allocate sort buffers: %s\n", strerror(errno));
+		return false;
+	}
+
+	bool ok = parallel_rows(out, threads, m->rows, radix_count_kernel, &args);
+	if (ok) {
+		/* bucket b holds worker 0's elements of b, then worker 1's, ... */
+		size_t at = 0;
+		for (unsigned int b = 0; b < RADIX_BUCKETS; ++b) {
+			args.starts[b] = at;
+			for (unsigned int t = 0; t < threads; ++t) {
+				const size_t count = args.counts[t * RADIX_BUCKETS + b];
+				args.counts[t * RADIX_BUCKETS + b] = at;
+				at += count;
+			}
+		}
+		args.starts[RADIX_BUCKETS] = at;
+		ok = parallel_rows(out, threads, m->rows, radix_scatter_kernel, &args)
+			&& parallel_rows(out, threads, RADIX_BUCKETS, radix_bucket_kernel, &args);
+	}
+	free(args.counts);
+	free(args.scratch);
+	return ok;
+}
+
+/* Counts the top bytes of the elements in rows [r0,r1) */
+static void radix_count_kernel (void* arg, unsigned int thread, size_t r0, size_t r1) {
+	Radix_Args_t* args = arg;
+	const Matrix_t* m = args->m;
+	size_t* counts = &args->counts[thread * RADIX_BUCKETS];
+	for (size_t i = r0; i < r1; ++i) {
+		const unsigned int* row = &m->data[i * m->stride];
+		for (size_t j = 0; j < m->cols; ++j) {
+			++counts[row[j] >> (32 - RADIX_BITS)];
+		}
+	}
+}
+
+/* Copies the elements in rows [r0,r1) into this worker's slots of their buckets */
+static void radix_scatter_kernel (void* arg, unsigned int thread, size_t r0, size_t r1) {
+	Radix_Args_t* args = arg;
+	const Matrix_t* m = args->m;
+	size_t* next = &args->counts[thread * RADIX_BUCKETS];
+	for (size_t i = r0; i < r1; ++i) {
+		const unsigned int* row = &m->data[i * m->stride];
+		for (size_t j = 0; j < m->cols; ++j) {
+			args->out[next[row[j] >> (32 - RADIX_BITS)]++] = row[j];
+		}
+	}
+}
+
+/* Sorts buckets [b0,b1) on the bytes below the top one */
+static void radix_bucket_kernel (void* arg, unsigned int thread, size_t b0, size_t b1) {
+	Radix_Args_t* args = arg;
+	for (size_t b = b0; b < b1; ++b) {
+		const size_t start = args->starts[b];
+		radix_sort_keys(&args->out[start], &args->scratch[start], args->starts[b + 1] - start,
+				32 - RADIX_BITS);
+	}
+}
+
+	/* 
+	 * PURPOSE: Sorts keys on their low bits, a byte at a time from the lowest.
+	 * 			Bytes every key shares are skipped, so narrow ranges cost few
+	 * 			passes. Fewer than RADIX_SMALL keys are insertion sorted.
+	 * INPUTS: 
+	 * 		   keys : the keys, sorted in place
+	 * 		   scratch : room for n keys
+	 * 		   n : number of keys
+	 * 		   bits : low bits to sort on, a multiple of RADIX_BITS, the keys must
+	 * 		   		  agree on the rest
+	 * RETURN: void
+	 **/
+static void radix_sort_keys (unsigned int* keys, unsigned int* scratch, size_t n, unsigned int bits) {
+	if (n < RADIX_SMALL) {
+		for (size_t k = 1; k < n; ++k) {
+			const unsigned int v = keys[k];
+			size_t at = k;
+			for (; at > 0 && keys[at - 1] > v; --at) {
+				keys[at] = keys[at - 1];
+			}
+			keys[at] = v;
+		}
+		return;
+	}
+
+	unsigned int* from = keys;
+	unsigned int* to = scratch;
+	for (unsigned int shift = 0; shift < bits; shift += RADIX_BITS) {
+		size_t counts[RADIX_BUCKETS] = { 0 };
+		for (size_t k = 0; k < n; ++k) {
+			++counts[(from[k] >> shift) & (RADIX_BUCKETS - 1)];
+		}
+		if (counts[(from[0] >> shift) & (RADIX_BUCKETS - 1)] == n) {
+			continue;
+		}
+		size_t at = 0;
+		for (unsigned int d = 0; d < RADIX_BUCKETS; ++d) {
+			const size_t count = counts[d];
+			counts[d] = at;
+			at += count;
+		}
+		for (size_t k = 0; k < n; ++k) {
+			to[counts[(from[k] >> shift) & (RADIX_BUCKETS - 1)]++] = from[k];
+		}
+		unsigned int* swap = from;
+		from = to;
+		to = swap;
+	}
+	if (from != keys) {
+		memcpy(keys, from, n * sizeof(unsigned int));
+	}
+}
+
+	/* 
+	 * PURPOSE: Reorders values so values[rank] is the value that would be there
+	 * 			if they were sorted, with none larger before it and none smaller
+	 * 			after it. Partitions three ways around a median of three pivot, so
+	 * 			runs of equal values do not slow it down.
+	 * INPUTS: 
+	 * 		   values : the values, reordered in place
+	 * 		   n : number of values
+	 * 		   rank : position to settle, below n
+	 * RETURN: void
+	 **/
+static void select_rank (unsigned int* values, size_t n, size_t rank) {
+	size_t lo = 0, hi = n;
+	while (hi - lo > 1) {
+		const unsigned int a = values[lo], b = values[lo + (hi - lo) / 2], c = values[hi - 1];
+		const unsigned int pivot = a < b ? (b < c ? b : (a < c ? c : a)) : (a < c ? a : (b < c ? c : b));
+
+		/* [lo,lt) < pivot, [lt,k) == pivot, [gt,hi) > pivot */
+		size_t lt = lo, k = lo, gt = hi;
+		while (k < gt) {
+			const unsigned int v = values[k];
+			if (v < pivot) {
+				values[k++] = values[lt];
+				values[lt++] = v;
+			}
+			else if (v > pivot) {
+				values[k] = values[--gt];
+				values[gt] = v;
+			}
+			else {
+				++k;
+			}
+		}
+		if (rank < lt) {
+			hi = lt;
+		}
+		else if (rank >= gt) {
+			lo = gt;
+		}
+		else {
+			return;
+		}
+	}
+}
+
+	/* 
+	 * PURPOSE: Sorts each of rows [r0,r1) in place
+	 * INPUTS: 
+	 * 		   arg : the Order_Args_t
+	 * 		   thread : unused
+	 * 		   r0, r1 : rows to sort
+	 * RETURN: void
+	 **/
+static void sort_rows_kernel (void* arg, unsigned int thread, size_t r0, size_t r1) {
+	Order_Args_t* args = arg;
+	Matrix_t* m = args->m;
+	unsigned int* scratch = malloc((m->cols ? m->cols : 1) * sizeof(unsigned int));
+	if (!scratch) {
+		__atomic_store_n(&args->failed, true, __ATOMIC_RELAXED);
+		return;
+	}
+	for (size_t i = r0; i < r1; ++i) {
+		radix_sort_keys(&m->data[i * m->stride], scratch, m->cols, 32);
+	}
+	free(scratch);
+}
+
+	/* 
+	 * PURPOSE: Stores the k largest elements of each of rows [r0,r1), largest
+	 * 			first, in the same rows of dest. A copy of the row is partitioned
+	 * 			around its k-th largest element and only those k are sorted.
+	 * INPUTS: 
+	 * 		   arg : the Order_Args_t
+	 * 		   thread : unused
+	 * 		   r0, r1 : rows to select from
+	 * RETURN: void
+	 **/
+static void top_k_kernel (void* arg, unsigned int thread, size_t r0, size_t r1) {
+	Order_Args_t* args = arg;
+	const Matrix_t* m = args->m;
+	const size_t k = args->k;
+	unsigned int* row = malloc((m->cols + k) * sizeof(unsigned int));
+	if (!row) {
+		__atomic_store_n(&args->failed, true, __ATOMIC_RELAXED);
+		return;
+	}
+	unsigned int* scratch = &row[m->cols];
+	for (size_t i = r0; i < r1; ++i) {
+		memcpy(row, &m->data[i * m->stride], m->cols * sizeof(unsigned int));
+		unsigned int* top = &row[m->cols - k];
+		select_rank(row, m->cols, m->cols - k);
+		radix_sort_keys(top, scratch, k, 32);
+		unsigned int* out = &args->dest->data[i * args->dest->stride];
+		for (size_t j = 0; j < k; ++j) {
+			out[j] = top[k - 1 - j];
+		}
+	}
+	free(row);
+}
+
+	/* 
+	 * PURPOSE: Finds which element of a source row or column of n a convolution
+	 * 			reads for position x, which may be past either edge
+	 * INPUTS: 
+	 * 		   x : position, negative or >= n past the edges
+	 * 		   n : length of the row or column, at least 1
+	 * 		   boundary : what is read past the edges
+	 * 		   index : receives the position to read
+	 * RETURN: True if an element is read, false if x is past an edge and reads zero
+	 **/
+static inline bool boundary_index (ptrdiff_t x, size_t n, Boundary_t boundary, size_t* index) {
+	if (x >= 0 && (size_t) x < n) {
+		*index = x;
+		return true;
+	}
+	switch (boundary) {
+	case BOUNDARY_CLAMP:
+		*index = x < 0 ? 0 : n - 1;
+		return true;
+	case BOUNDARY_WRAP:
+		*index = x < 0 ? n - 1 - (size_t) (-(x + 1)) % n : (size_t) x % n;
+		return true;
+	default:
+		return false;
+	}
+}
+
+	/* 
+	 * PURPOSE: Copies source row r into pad with the columns the kernel reads past
+	 * 			the left and right edges, so pad[j + v] is what tap column v reads
+	 * 			for output column j
+	 * INPUTS: 
+	 * 		   args : the convolution
+	 * 		   r : source row, may be past the top or bottom edge
+	 * 		   pad : receives width elements
+	 * 		   width : elements to fill, at least cols + kernel cols - 1
+	 * RETURN: void
+	 **/
+static void pad_row (const Conv_Args_t* args, ptrdiff_t r, unsigned int* pad, size_t width) {
+	const Matrix_t* src = args->src;
+	const ptrdiff_t left = args->kernel->cols / 2;
+	size_t row = 0;
+	if (!boundary_index(r, src->rows, args->boundary, &row)) {
+		memset(pad, 0, width * sizeof(unsigned int));
+		return;
+	}
+	const unsigned int* data = &src->data[row * src->stride];
+	for (ptrdiff_t k = 0; k < left; ++k) {
+		size_t col = 0;
+		pad[k] = boundary_index(k - left, src->cols, args->boundary, &col) ? data[col] : 0;
+	}
+	memcpy(&pad[left], data, src->cols * sizeof(unsigned int));
+	for (ptrdiff_t k = left + src->cols; k < (ptrdiff_t) width; ++k) {
+		size_t col = 0;
+		pad[k] = boundary_index(k - left, src->cols, args->boundary, &col) ? data[col] : 0;
+	}
+}
+
+	/* 
+	 * PURPOSE: Adds p[k] * w to acc[k] for a tile of CONV_TILE elements, two 64
+	 * 			bit products per multiply
+	 * INPUTS: 
+	 * 		   acc : the tile's sums
+	 * 		   p : source elements under one kernel weight
+	 * 		   w : the weight
+	 * RETURN: void
+	 **/
+static inline void conv_accumulate (unsigned long long* restrict acc, const unsigned int* restrict p,
+						unsigned int w) {
+#ifdef __SSE2__
+	const __m128i weight = _mm_set1_epi32(w);
+	const __m128i zero = _mm_setzero_si128();
+	for (size_t k = 0; k < CONV_TILE; k += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i*) &p[k]);
+		__m128i lo = _mm_mul_epu32(_mm_unpacklo_epi32(x, zero), weight);
+		__m128i hi = _mm_mul_epu32(_mm_unpackhi_epi32(x, zero), weight);
+		__m128i* out = (__m128i*) &acc[k];
+		_mm_storeu_si128(out, _mm_add_epi64(_mm_loadu_si128(out), lo));
+		_mm_storeu_si128(out + 1, _mm_add_epi64(_mm_loadu_si128(out + 1), hi));
+	}
+#else
+	for (size_t k = 0; k < CONV_TILE; ++k) {
+		acc[k] += (unsigned long long) p[k] * w;
+	}
+#endif
+}
+
+	/* 
+	 * PURPOSE: Adds p[k] * w to acc[k] for a tile of CONV_TILE 64 bit partial
+	 * 			sums, multiplying their low and high halves separately
+	 * INPUTS: 
+	 * 		   acc : the tile's sums
+	 * 		   p : partial sums under one kernel weight
+	 * 		   w : the weight
+	 * RETURN: void
+	 **/
+static inline void conv_accumulate_wide (unsigned long long* restrict acc,
+						const unsigned long long* restrict p, unsigned int w) {
+#ifdef __SSE2__
+	const __m128i weight = _mm_set1_epi32(w);
+	for (size_t k = 0; k < CONV_TILE; k += 2) {
+		__m128i x = _mm_loadu_si128((const __m128i*) &p[k]);
+		__m128i lo = _mm_mul_epu32(x, weight);
+		__m128i hi = _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(x, 32), weight), 32);
+		__m128i* out = (__m128i*) &acc[k];
+		_mm_storeu_si128(out, _mm_add_epi64(_mm_loadu_si128(out), _mm_add_epi64(lo, hi)));
+	}
+#else
+	for (size_t k = 0; k < CONV_TILE; ++k) {
+		acc[k] += p[k] * w;
+	}
+#endif
+}
+
+	/* 
+	 * PURPOSE: Stores n sums into a row of the result, clamping them to UINT_MAX
+	 * INPUTS: 
+	 * 		   out : result elements
+	 * 		   acc : the sums
+	 * 		   n : how many to store
+	 * RETURN: how many were clamped
+	 **/
+static inline size_t conv_store (unsigned int* out, const unsigned long long* acc, size_t n) {
+	size_t clamped = 0;
+	for (size_t k = 0; k < n; ++k) {
+		clamped += acc[k] > UINT_MAX;
+		out[k] = acc[k] > UINT_MAX ? UINT_MAX : acc[k];
+	}
+	return clamped;
+}
+
+	/* 
+	 * PURPOSE: Splits a kernel into a column of weights times a row of weights,
+	 * 			kernel[u][v] == col_weights[u] * row_weights[v], if it can be
+	 * 			split exactly in whole numbers
+	 * INPUTS: 
+	 * 		   kernel : the kernel
+	 * 		   row_weights : receives kernel->cols weights
+	 * 		   col_weights : receives kernel->rows weights
+	 * RETURN: True if the kernel is their product
+	 **/
+static bool separable_weights (const Matrix_t* kernel, unsigned int* row_weights,
+						unsigned int* col_weights) {
+	const size_t kh = kernel->rows;
+	const size_t kw = kernel->cols;
+	const unsigned int* first = NULL;
+	for (size_t u = 0; u < kh && !first; ++u) {
+		for (size_t v = 0; v < kw; ++v) {
+			if (kernel->data[u * kernel->stride + v]) {
+				first = &kernel->data[u * kernel->stride];
+				break;
+			}
+		}
+	}
+	if (!first) {
+		return true;
+	}
+
+	/* the first nonzero row divided by its gcd is the smallest whole row factor */
+	unsigned int g = 0;
+	size_t pivot = 0;
+	for (size_t v = 0; v < kw; ++v) {
+		unsigned int a = first[v], b = g;
+		while (b) {
+			unsigned int t = a % b;
+			a = b;
+			b = t;
+		}
+		g = a;
+		pivot = first[pivot] ? pivot : v;
+	}
+	for (size_t v = 0; v < kw; ++v) {
+		row_weights[v] = first[v] / g;
+	}
+	for (size_t u = 0; u < kh; ++u) {
+		const unsigned int* row = &kernel->data[u * kernel->stride];
+		col_weights[u] = row[pivot] / row_weights[pivot];
+		for (size_t v = 0; v < kw; ++v) {
+			if ((unsigned long long) col_weights[u] * row_weights[v] != row[v]) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+	/* 
+	 * PURPOSE: Convolves rows [r0,r1) with every weight of the kernel. The padded
+	 * 			source rows under the kernel are kept in a ring, so each is padded
+	 * 			once per band however tall the kernel is.
+	 * INPUTS: 
+	 * 		   arg : the Conv_Args_t
+	 * 		   thread : unused
+	 * 		   r0, r1 : output rows
+	 * RETURN: void
+	 **/
+static void conv_direct_kernel (void* arg, unsigned int thread, size_t r0, size_t r1) {
+	Conv_Args_t* args = arg;
+	const Matrix_t* kernel = args->kernel;
+	const size_t kh = kernel->rows;
+	const size_t kw = kernel->cols;
+	const ptrdiff_t top = kh / 2;
+	const size_t width = args->padded_cols + kw - 1;
+	const size_t cols = args->src->cols;
+	unsigned int* ring = malloc(kh * width * sizeof(unsigned int));
+	unsigned long long* acc = malloc(CONV_TILE * sizeof(unsigned long long));
+	if (!ring || !acc) {
+		free(ring);
+		free(acc);
+		__atomic_store_n(&args->failed, true, __ATOMIC_RELAXED);
+		return;
+	}
+
+	/* slot (i + u) % kh holds the source row tap row u reads for output row i */
+	for (size_t u = 0; u + 1 < kh; ++u) {
+		pad_row(args, (ptrdiff_t) (r0 + u) - top, &ring[(r0 + u) % kh * width], width);
+	}
+	size_t clamped = 0;
+	for (size_t i = r0; i < r1; ++i) {
+		pad_row(args, (ptrdiff_t) (i + kh - 1) - top, &ring[(i + kh - 1) % kh * width], width);
+		unsigned int* out = &args->dest->data[i * args->dest->stride];
+		for (size_t t = 0; t < cols; t += CONV_TILE) {
+			memset(acc, 0, CONV_TILE * sizeof(unsigned long long));
+			for (size_t u = 0; u < kh; ++u) {
+				const unsigned int* p = &ring[(i + u) % kh * width + t];
+				const unsigned int* w = &kernel->data[u * kernel->stride];
+				for (size_t v = 0; v < kw; ++v) {
+					if (w[v]) {
+						conv_accumulate(acc, &p[v], w[v]);
+					}
+				}
+			}
+			clamped += conv_store(&out[t], acc, cols - t < CONV_TILE ? cols - t : CONV_TILE);
+		}
+	}
+	__atomic_add_fetch(&args->clamped, clamped, __ATOMIC_RELAXED);
+	free(ring);
+	free(acc);
+}
+
+	/* 
+	 * PURPOSE: Pads source row r and sums it along the row with the row weights
+	 * INPUTS: 
+	 * 		   args : the convolution
+	 * 		   r : source row, may be past the top or bottom edge
+	 * 		   pad : scratch of padded_cols + kernel cols - 1 elements
+	 * 		   sums : receives padded_cols sums
+	 * RETURN: void
+	 **/
+static void conv_row_pass (const Conv_Args_t* args, ptrdiff_t r, unsigned int* pad,
+						unsigned long long* sums) {
+	const size_t kw = args->kernel->cols;
+	const size_t padded = args->padded_cols;
+	pad_row(args, r, pad, padded + kw - 1);
+	memset(sums, 0, padded * sizeof(unsigned long long));
+	for (size_t t = 0; t < padded; t += CONV_TILE) {
+		for (size_t v = 0; v < kw; ++v) {
+			if (args->row_weights[v]) {
+				conv_accumulate(&sums[t], &pad[t + v], args->row_weights[v]);
+			}
+		}
+	}
+}
+
+	/* 
+	 * PURPOSE: Convolves rows [r0,r1) with a separable kernel, first along each
+	 * 			source row with the row weights, then down the columns of those
+	 * 			sums with the column weights. A kh x kw kernel costs kh + kw
+	 * 			multiplies per element instead of kh * kw.
+	 * INPUTS: 
+	 * 		   arg : the Conv_Args_t
+	 * 		   thread : unused
+	 * 		   r0, r1 : output rows
+	 * RETURN: void
+	 **/
+static void conv_separable_kernel (void* arg, unsigned int thread, size_t r0, size_t r1) {
+	Conv_Args_t* args = arg;
+	const size_t kh = args->kernel->rows;
+	const ptrdiff_t top = kh / 2;
+	const size_t padded = args->padded_cols;
+	const size_t cols = args->src->cols;
+	unsigned int* pad = malloc((padded + args->kernel->cols - 1) * sizeof(unsigned int));
+	unsigned long long* ring = malloc(kh * padded * sizeof(unsigned long long));
+	unsigned long long* acc = malloc(CONV_TILE * sizeof(unsigned long long));
+	if (!pad || !ring || !acc) {
+		free(pad);
+		free(ring);
+		free(acc);
+		__atomic_store_n(&args->failed, true, __ATOMIC_RELAXED);
+		return;
+	}
+
+	/* slot (i + u) % kh holds the row sums of the source row tap row u reads */
+	for (size_t u = 0; u + 1 < kh; ++u) {
+		conv_row_pass(args, (ptrdiff_t) (r0 + u) - top, pad, &ring[(r0 + u) % kh * padded]);
+	}
+	size_t clamped = 0;
+	for (size_t i = r0; i < r1; ++i) {
+		conv_row_pass(args, (ptrdiff_t) (i + kh - 1) - top, pad, &ring[(i + kh - 1) % kh * padded]);
+		unsigned int* out = &args->dest->data[i * args->dest->stride];
+		for (size_t t = 0; t < cols; t += CONV_TILE) {
+			memset(acc, 0, CONV_TILE * sizeof(unsigned long long));
+			for (size_t u = 0; u < kh; ++u) {
+				if (args->col_weights[u]) {
+					conv_accumulate_wide(acc, &ring[(i + u) % kh * padded + t], args->col_weights[u]);
+				}
+			}
+			clamped += conv_store(&out[t], acc, cols - t < CONV_TILE ? cols - t : CONV_TILE);
+		}
+	}
+	__atomic_add_fetch(&args->clamped, clamped, __ATOMIC_RELAXED);
+	free(pad);
+	free(ring);
+	free(acc);
+}
+
+	/* 
+	 * PURPOSE: Convolves rows [r0,r1) with a box kernel. For each CONV_SAT_ROWS
+	 * 			output rows a summed-area table of the padded source under them
+	 * 			is built, then each window sum is four lookups.
+	 * INPUTS: 
+	 * 		   arg : the Conv_Args_t
+	 * 		   thread : unused
+	 * 		   r0, r1 : output rows
+	 * RETURN: void
+	 **/
+static void conv_box_kernel (void* arg, unsigned int thread, size_t r0, size_t r1) {
+	Conv_Args_t* args = arg;
+	const size_t kh = args->kernel->rows;
+	const size_t kw = args->kernel->cols;
+	const ptrdiff_t top = kh / 2;
+	const size_t cols = args->src->cols;
+	const size_t width = cols + kw - 1;
+	const size_t table_cols = width + 1;
+	unsigned int* pad = malloc(width * sizeof(unsigned int));
+	unsigned long long* table = malloc((CONV_SAT_ROWS + kh) * table_cols * sizeof(unsigned long long));
+	unsigned long long* acc = malloc(cols * sizeof(unsigned long long));
+	if (!pad || !table || !acc) {
+		free(pad);
+		free(table);
+		free(acc);
+		__atomic_store_n(&args->failed, true, __ATOMIC_RELAXED);
+		return;
+	}
+
+	size_t clamped = 0;
+	memset(table, 0, table_cols * sizeof(unsigned long long));
+	for (size_t c0 = r0; c0 < r1; c0 += CONV_SAT_ROWS) {
+		const size_t c1 = r1 - c0 < CONV_SAT_ROWS ? r1 : c0 + CONV_SAT_ROWS;
+
+		/* table[y + 1][x + 1] sums padded rows 0..y, columns 0..x of this chunk */
+		for (size_t y = 0; y < c1 - c0 + kh - 1; ++y) {
+			pad_row(args, (ptrdiff_t) (c0 + y) - top, pad, width);
+			const unsigned long long* above = &table[y * table_cols];
+			unsigned long long* sums = &table[(y + 1) * table_cols];
+			unsigned long long run = 0;
+			sums[0] = 0;
+			for (size_t x = 0; x < width; ++x) {
+				run += pad[x];
+				sums[x + 1] = above[x + 1] + run;
+			}
+		}
+		for (size_t i = c0; i < c1; ++i) {
+			const unsigned long long* upper = &table[(i - c0) * table_cols];
+			const unsigned long long* lower = &table[(i - c0 + kh) * table_cols];
+			for (size_t j = 0; j < cols; ++j) {
+				acc[j] = (lower[j + kw] - upper[j + kw] - lower[j] + upper[j]) * args->box_weight;
+			}
+			clamped += conv_store(&args->dest->data[i * args->dest->stride], acc, cols);
+		}
+	}
+	__atomic_add_fetch(&args->clamped, clamped, __ATOMIC_RELAXED);
+	free(pad);
+	free(table);
+	free(acc);
+}
+
+	/* 
+	 * PURPOSE: Transposes the 4x4 block at src into dest entirely in registers.
+	 * INPUTS: 
+	 * 		   src : top left element of the source block
+	 * 		   src_stride : elements between consecutive source rows
+	 * 		   dest : top left element of the destination block
+	 * 		   dest_stride : elements between consecutive destination rows
+	 * RETURN: void
+	 **/
+static inline void transpose_4x4 (const unsigned int* src, size_t src_stride,
+						unsigned int* dest, size_t dest_stride) {
+#ifdef __SSE2__
+	__m128i r0 = _mm_loadu_si128((const __m128i*) &src[0 * src_stride]);
+	__m128i r1 = _mm_loadu_si128((const __m128i*) &src[1 * src_stride]);
+	__m128i r2 = _mm_loadu_si128((const __m128i*) &src[2 * src_stride]);
+	__m128i r3 = _mm_loadu_si128((const __m128i*) &src[3 * src_stride]);
+
+	__m128i t0 = _mm_unpacklo_epi32(r0, r1);
+	__m128i t1 = _mm_unpacklo_epi32(r2, r3);
+	__m128i t2 = _mm_unpackhi_epi32(r0, r1);
+	__m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+	_mm_storeu_si128((__m128i*) &dest[0 * dest_stride], _mm_unpacklo_epi64(t0, t1));
+	_mm_storeu_si128((__m128i*) &dest[1 * dest_stride], _mm_unpackhi_epi64(t0, t1));
+	_mm_storeu_si128((__m128i*) &dest[2 * dest_stride], _mm_unpacklo_epi64(t2, t3));
+	_mm_storeu_si128((__m128i*) &dest[3 * dest_stride], _mm_unpackhi_epi64(t2, t3));
+#else
+	for (unsigned int i = 0; i < 4; ++i) {
+		for (unsigned int j = 0; j < 4; ++j) {
+			dest[j * dest_stride + i] = src[i * src_stride + j];
+		}
+	}
+#endif
+}
+
+	/* 
+	 * PURPOSE: Transposes the tile [r0,r1) x [c0,c1) of src into dest using 4x4
+	 * 			register blocks, finishing ragged edges one element at a time.
+	 * INPUTS: 
+	 * 		   src, src_stride : source buffer and its row length
+	 * 		   dest, dest_stride : destination buffer and its row length
+	 * 		   r0, r1, c0, c1 : bounds of the source tile
+	 * RETURN: void
+	 **/
+static void transpose_tile (const unsigned int* src, size_t src_stride,
+						unsigned int* dest, size_t dest_stride,
+						size_t r0, size_t r1, size_t c0, size_t c1) {
+	size_t i = r0;
+	for (; i + 4 <= r1; i += 4) {
+		size_t j = c0;
+		for (; j + 4 <= c1; j += 4) {
+			transpose_4x4(&src[i * src_stride + j], src_stride,
+					&dest[j * dest_stride + i], dest_stride);
+		}
+		for (; j < c1; ++j) {
+			for (size_t k = i; k < i + 4; ++k) {
+				dest[j * dest_stride + k] = src[k * src_stride + j];
+			}
+		}
+	}
+	for (; i < r1; ++i) {
+		for (size_t j = c0; j < c1; ++j) {
+			dest[j * dest_stride + i] = src[i * src_stride + j];
+		}
+	}
+}
+
+	/* 
+	 * PURPOSE: Cache oblivious transpose. Halves the longer side of the source
+	 * 			region until it fits in a TRANSPOSE_TILE square tile.
+	 * INPUTS: 
+	 * 		   src, src_stride : source buffer and its row length
+	 * 		   dest, dest_stride : destination buffer and its row length
+	 * 		   r0, r1, c0, c1 : bounds of the source region
+	 * RETURN: void
+	 **/
+static void transpose_recursive (const unsigned int* src, size_t src_stride,
+						unsigned int* dest, size_t dest_stride,
+						size_t r0, size_t r1, size_t c0, size_t c1) {
+	const size_t rows = r1 - r0;
+	const size_t cols = c1 - c0;
+	if (rows <= TRANSPOSE_TILE && cols <= TRANSPOSE_TILE) {
+		transpose_tile(src, src_stride, dest, dest_stride, r0, r1, c0, c1);
+	}
+	else if (rows >= cols) {
+		const size_t mid = r0 + rows / 2;
+		transpose_recursive(src, src_stride, dest, dest_stride, r0, mid, c0, c1);
+		transpose_recursive(src, src_stride, dest, dest_stride, mid, r1, c0, c1);
+	}
+	else {
+		const size_t mid = c0 + cols / 2;
+		transpose_recursive(src, src_stride, dest, dest_stride, r0, r1, c0, mid);
+		transpose_recursive(src, src_stride, dest, dest_stride, r0, r1, mid, c1);
+	}
+}
+
+	/* 
+	 * PURPOSE: Swaps tile (bi,bj) of a square matrix with its mirror tile (bj,bi),
+	 * 			transposing both. Diagonal tiles (bi == bj) are transposed onto
+	 * 			themselves. Each 4x4 block pair is held in registers while swapped.
+	 * INPUTS: 
+	 * 		   data : square matrix buffer
+	 * 		   stride : elements from the start of one row to the next
+	 * 		   bi, bi_end : row bounds of the tile
+	 * 		   bj, bj_end : col bounds of the tile, bj >= bi
+	 * RETURN: void
+	 **/
+static void transpose_swap_tiles (unsigned int* data, size_t stride,
+						size_t bi, size_t bi_end, size_t bj, size_t bj_end) {
+	unsigned int upper[16];
+
+	size_t i = bi;
+	for (; i + 4 <= bi_end; i += 4) {
+		/* on a diagonal tile only visit blocks on or above the diagonal */
+		size_t j = (bi == bj) ? i : bj;
+		for (; j + 4 <= bj_end; j += 4) {
+			unsigned int* a = &data[i * stride + j];
+			unsigned int* b = &data[j * stride + i];
+			transpose_4x4(a, stride, upper, 4);
+			if (a != b) {
+				transpose_4x4(b, stride, a, stride);
+			}
+			for (unsigned int k = 0; k < 4; ++k) {
+				memcpy(&b[k * stride], &upper[k * 4], 4 * sizeof(unsigned int));
+			}
+		}
+		for (; j < bj_end; ++j) {
+			for (size_t k = i; k < i + 4; ++k) {
+				if (j > k) {
+					unsigned int tmp = data[k * stride + j];
+					data[k * stride + j] = data[j * stride + k];
+					data[j * stride + k] = tmp;
+				}
+			}
+		}
+	}
+	for (; i < bi_end; ++i) {
+		for (size_t j = (bi == bj) ? i + 1 : bj; j < bj_end; ++j) {
+			unsigned int tmp = data[i * stride + j];
+			data[i * stride + j] = data[j * stride + i];
+			data[j * stride + i] = tmp;
+		}
+	}
+}
+
+
+	/* 
+	 * PURPOSE: Creates a matrix whose data is a private mapping of part of a file.
+	 * 			Falls back to reading the data onto the heap when the offset is not
+	 * 			page aligned on this machine or the matrix is empty.
+	 * INPUTS: 
+	 * 		   out : stream diagnostics are printed to
+	 * 		   m : receives the new matrix
+	 * 		   name : matrix name
+	 * 		   rows, cols : matrix dimensions
+	 * 		   fd : open file holding the data
+	 * 		   offset : where the data starts in the file
+	 * RETURN: True if the matrix was created.
+	 **/
+static bool map_matrix (FILE* out, Matrix_t** m, const char* name, size_t rows, size_t cols,
+						int fd, off_t offset) {
+	const size_t bytes = rows * cols * sizeof(unsigned int);
+	if (bytes == 0 || offset % sysconf(_SC_PAGESIZE) != 0) {
+		if (!create_matrix(out, m, name, rows, cols)) {
+			return false;
+		}
+		if (!read_fully(fd, (*m)->data, bytes, offset)) {
+			fprintf(out, "FAILED TO READ MATRIX DATA: %s\n", strerror(errno));
+			destroy_matrix(m);
+			return false;
+		}
+		return true;
+	}
+
+	void* data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset);
+	if (data == MAP_FAILED) {
+		fprintf(out, "FAILED TO MAP MATRIX DATA: %s\n", strerror(errno));
+		return false;
+	}
+	*m = calloc(1, sizeof(Matrix_t));
+	if (!(*m)) {
+		munmap(data, bytes);
+		return false;
+	}
+	snprintf((*m)->name, MATRIX_NAME_LEN, "%s", name);
+	(*m)->rows = rows;
+	(*m)->cols = cols;
+	(*m)->stride = cols;
+	(*m)->data = data;
+	(*m)->mapped_bytes = bytes;
+	pthread_rwlock_init(&(*m)->lock, NULL);
+	return true;
 }
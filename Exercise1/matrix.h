@@ -1,27 +1,123 @@
 #ifndef _MATRIX_H_
 #define _MATRIX_H_
 
+#include <stdio.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/types.h>
+
 #define MATRIX_NAME_LEN 25
 
-typedef struct {
+typedef struct Matrix {
 	char name[MATRIX_NAME_LEN];
-	unsigned int rows;
-	unsigned int cols;
-	unsigned int *data;
+	size_t rows;
+	size_t cols;
+	size_t stride; /* elements from the start of one row to the next, cols unless a view */
+	unsigned int *data; /* 64 byte aligned, huge page aligned once it is at least 2 MiB */
+	struct Matrix* parent; /* matrix whose data a view shares, null if the data is its own */
+	unsigned int views; /* number of views sharing this matrix's data */
+	bool released; /* destroyed while views remained, freed along with the last view */
+	size_t mapped_bytes; /* length of the mapping data points into, 0 if data is from the heap */
+	unsigned long long last_used; /* stamp of the last lookup, for least recently used eviction */
+	unsigned long long pin_epoch; /* not evicted while this matches the current pin epoch */
+	pthread_rwlock_t lock; /* held by the server while a command uses the matrix */
 }Matrix_t;
 
-bool create_matrix (Matrix_t** new_matrix, const char* name, const unsigned int rows, const unsigned int cols);
+/* Summary of a row or column of a matrix */
+typedef struct {
+	unsigned long long sum;
+	unsigned int min;
+	unsigned int max;
+	unsigned long long count;
+}Reduction_t;
+
+/*
+ * Element-wise operators. Each one combines an element x of the first matrix
+ * with y, the matching element of a second matrix or a scalar. clamp limits x
+ * to [y,z] and only has a scalar form. Shifts of 32 or more give 0.
+ */
+typedef enum {
+	ELEMENTWISE_ADD,
+	ELEMENTWISE_SUB,
+	ELEMENTWISE_AND,
+	ELEMENTWISE_OR,
+	ELEMENTWISE_XOR,
+	ELEMENTWISE_MIN,
+	ELEMENTWISE_MAX,
+	ELEMENTWISE_MUL,
+	ELEMENTWISE_SHL,
+	ELEMENTWISE_SHR,
+	ELEMENTWISE_CLAMP,
+	ELEMENTWISE_NUM_OPS
+}Elementwise_Op_t;
+
+/* Equal width bins covering every value of a matrix, from histogram_matrix */
+typedef struct {
+	unsigned int min; /* smallest element, where the first bin starts */
+	unsigned int max; /* largest element, where the last bin ends */
+	unsigned long long width; /* values in each bin, the last may hold fewer */
+	unsigned int bins; /* bins used, fewer than asked for when there are fewer values */
+}Histogram_t;
+
+/* What a convolution reads for elements past the edge of its source */
+typedef enum {
+	BOUNDARY_ZERO, /* zero */
+	BOUNDARY_CLAMP, /* the nearest edge element */
+	BOUNDARY_WRAP /* the element from the opposite edge, as if the matrix repeats */
+}Boundary_t;
+
+/* Where the bytes of matrix data are, as reported by the mem command */
+typedef struct {
+	size_t resident_bytes;
+	size_t spilled_bytes;
+	size_t budget_bytes;
+	unsigned int num_resident;
+	unsigned int num_spilled;
+}Memory_Usage_t;
+
+bool create_matrix (FILE* out, Matrix_t** new_matrix, const char* name, const size_t rows, const size_t cols);
+bool create_view (FILE* out, Matrix_t** view, const char* name, Matrix_t* parent, size_t r0, size_t c0,
+						size_t rows, size_t cols);
 void destroy_matrix (Matrix_t** m); 
-bool write_matrix (const char* matrix_output_filename, Matrix_t* m);
-bool read_matrix (const char* matrix_input_filename, Matrix_t** m);
-int sum_matrix (Matrix_t* m);
-bool add_matrices (Matrix_t* a, Matrix_t* b, Matrix_t* c); 
-bool bitwise_shift_matrix (Matrix_t* a, char direction, unsigned int shift);
-bool duplicate_matrix (Matrix_t* src, Matrix_t* dest);
-bool equal_matrices (Matrix_t* a, Matrix_t* b); 
+bool write_matrix (FILE* out, const char* matrix_output_filename, Matrix_t* m);
+bool read_matrix (FILE* out, const char* matrix_input_filename, Matrix_t** m);
+bool save_workspace (FILE* out, const char* filename, Matrix_t** mats, unsigned int num_mats);
+bool load_workspace (FILE* out, const char* filename, Matrix_t** mats, unsigned int num_mats);
+unsigned long long sum_matrix (FILE* out, Matrix_t* m);
+bool reduce_rows (FILE* out, Matrix_t* a, Reduction_t* result);
+bool reduce_cols (FILE* out, Matrix_t* a, Reduction_t* result);
+bool reduction_matrix (FILE* out, Matrix_t* a, Matrix_t* r, bool by_row);
+bool histogram_matrix (FILE* out, Matrix_t* m, unsigned int bins, Histogram_t* hist, unsigned long long* counts);
+bool distinct_values (FILE* out, Matrix_t* m, unsigned long long* distinct);
+bool sort_matrix (FILE* out, Matrix_t* m, bool by_row);
+bool top_k_matrix (FILE* out, Matrix_t* m, size_t k, Matrix_t* dest);
+bool rank_value (FILE* out, Matrix_t* m, size_t rank, unsigned int* value);
+bool add_matrices (FILE* out, Matrix_t* a, Matrix_t* b, Matrix_t* c); 
+bool elementwise_matrices (FILE* out, Elementwise_Op_t op, Matrix_t* a, Matrix_t* b, Matrix_t* c);
+bool elementwise_scalar (FILE* out, Elementwise_Op_t op, Matrix_t* a, unsigned int y, unsigned int z, Matrix_t* c);
+bool elementwise_command (const char* name, unsigned int num_cmds, Elementwise_Op_t* op, bool* scalar);
+const char* elementwise_op_name (Elementwise_Op_t op);
+bool bitwise_shift_matrix (FILE* out, Matrix_t* a, char direction, unsigned int shift);
+bool duplicate_matrix (FILE* out, Matrix_t* src, Matrix_t* dest);
+bool equal_matrices (FILE* out, Matrix_t* a, Matrix_t* b); 
 void display_matrix (Matrix_t* m); 
-bool random_matrix(Matrix_t* m, unsigned int start_range, unsigned int end_range);
-unsigned int add_matrix_to_array (Matrix_t** mats, Matrix_t* new_matrix, unsigned int num_mats);
+void fdisplay_matrix (FILE* out, Matrix_t* m);
+bool transpose_matrix (FILE* out, Matrix_t* src, Matrix_t* dest);
+bool convolve_matrix (FILE* out, Matrix_t* src, Matrix_t* kernel, Matrix_t* dest, Boundary_t boundary);
+bool transpose_matrix_in_place (FILE* out, Matrix_t* m);
+bool random_matrix(FILE* out, Matrix_t* m, unsigned int start_range, unsigned int end_range);
+unsigned int add_matrix_to_array (FILE* out, Matrix_t** mats, Matrix_t* new_matrix, unsigned int num_mats);
+void touch_matrix (Matrix_t* m);
+void unpin_matrices (void);
+void set_memory_budget (size_t bytes);
+void enforce_memory_budget (FILE* out, Matrix_t** mats, unsigned int num_mats);
+bool spill_matrix (FILE* out, Matrix_t** mats, unsigned int idx);
+int reload_spilled_matrix (FILE* out, Matrix_t** mats, unsigned int num_mats, const char* name);
+void memory_usage (Matrix_t** mats, unsigned int num_mats, Memory_Usage_t* usage);
+unsigned int spilled_matrix_count (void);
+bool is_spilled_matrix (const char* name);
+bool copy_spilled_matrix (unsigned int k, char name[MATRIX_NAME_LEN], size_t* rows,
+						size_t* cols, int fd, off_t offset);
 
 
 #endif
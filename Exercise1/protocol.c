@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "protocol.h"
+
+/* 
+ * PURPOSE: Opens a connection to a matlab server listening on a unix socket
+ * INPUTS: 
+ * 		   socket_path : filesystem path of the server's socket
+ * RETURN: connected file descriptor, or -1 if the connection failed
+ **/
+int connect_to_server (const char* socket_path) {
+
+	struct sockaddr_un addr;
+	if (!socket_path || strlen(socket_path) + 1 > sizeof(addr.sun_path)) {
+		printf("\nSocket path is null or too long\n");
+		return -1;
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		perror("FAILED TO CREATE SOCKET\n");
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socket_path);
+	if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+		perror("FAILED TO CONNECT TO SERVER\n");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* 
+ * PURPOSE: Writes all of buf to fd, waiting for room if fd is non blocking
+ * INPUTS: 
+ * 		   fd : socket to write to
+ * 		   buf : bytes to write
+ * 		   len : number of bytes in buf
+ * RETURN: True if every byte was written. False if the peer went away.
+ **/
+bool send_all (int fd, const char* buf, size_t len) {
+
+	while (len > 0) {
+		ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				struct pollfd p = { .fd = fd, .events = POLLOUT };
+				poll(&p, 1, -1);
+				continue;
+			}
+			return false;
+		}
+		buf += n;
+		len -= n;
+	}
+	return true;
+}
+
+/* 
+ * PURPOSE: Reads one reply from the server, up to RESPONSE_END
+ * INPUTS: 
+ * 		   fd : connected socket
+ * 		   out : stream the reply is copied to, may be null to discard it
+ * RETURN: True if a whole reply was read. False if the connection closed first.
+ **/
+bool read_response (int fd, FILE* out) {
+
+	char buf[4096];
+	for (;;) {
+		ssize_t n = recv(fd, buf, sizeof(buf), 0);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		char* end = memchr(buf, RESPONSE_END, n);
+		size_t len = end ? (size_t) (end - buf) : (size_t) n;
+		if (out) {
+			fwrite(buf, 1, len, out);
+		}
+		if (end) {
+			return true;
+		}
+	}
+}
@@ -0,0 +1,16 @@
+#ifndef _PROTOCOL_H_
+#define _PROTOCOL_H_
+
+/*
+ * Wire format between matlab --serve and its clients. A request is one
+ * command line ending in '\n'. The reply is everything the command printed
+ * followed by a single RESPONSE_END byte.
+ */
+#define RESPONSE_END '\0'
+#define MAX_REQUEST_LEN 4096
+
+int connect_to_server (const char* socket_path);
+bool send_all (int fd, const char* buf, size_t len);
+bool read_response (int fd, FILE* out);
+
+#endif
@@ -0,0 +1,406 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "command.h"
+#include "matrix.h"
+#include "scheduler.h"
+#include "workspace.h"
+
+void run_commands (Commands_t* cmd, Matrix_t** mats, unsigned int num_mats, FILE* out);
+
+/* One command of the batch and its place in the dependency graph */
+typedef struct {
+	Commands_t* cmd;
+	Command_Access_t access;
+	bool barrier; /* ordered against every other command */
+	unsigned int* successors; /* commands that wait for this one */
+	unsigned int num_successors;
+	unsigned int pending; /* earlier commands this one still waits for */
+	char* output;
+	size_t output_len;
+	int output_error; /* errno if the output could not be captured */
+	bool done;
+} Task_t;
+
+/*
+ * Ready commands of one worker. The owner pushes and pops at the bottom,
+ * so it runs the commands it just made ready while their matrices are
+ * still in its cache. Idle workers steal from the top, the oldest.
+ */
+typedef struct {
+	pthread_mutex_t mutex;
+	unsigned int* tasks;
+	unsigned int top;
+	unsigned int bottom;
+} Deque_t;
+
+typedef struct {
+	Task_t* tasks;
+	unsigned int num_tasks;
+	Deque_t* deques;
+	unsigned int num_workers;
+	Matrix_t** mats;
+	unsigned int num_mats;
+	FILE* out;
+
+	/* idle workers sleep until a command is queued or the batch is done */
+	pthread_mutex_t idle_mutex;
+	pthread_cond_t idle_cond;
+	unsigned int queued;
+	unsigned int remaining;
+
+	/* output is printed once every command before it has been printed */
+	pthread_mutex_t flush_mutex;
+	unsigned int next_flush;
+} Batch_t;
+
+typedef struct {
+	Batch_t* batch;
+	unsigned int worker;
+} Worker_t;
+
+/*
+ * PURPOSE: Tells whether two commands must keep their order, which they must
+ * 			when one changes a matrix the other uses
+ * INPUTS:
+ * 		   a, b : the commands
+ * RETURN: True if b must wait for a
+ **/
+static bool depends (const Task_t* a, const Task_t* b) {
+	if (a->barrier || b->barrier) {
+		return true;
+	}
+	for (unsigned int i = 0; i < a->access.num_writes; ++i) {
+		for (unsigned int j = 0; j < b->access.num_reads; ++j) {
+			if (strcmp(a->access.writes[i], b->access.reads[j]) == 0) {
+				return true;
+			}
+		}
+		for (unsigned int j = 0; j < b->access.num_writes; ++j) {
+			if (strcmp(a->access.writes[i], b->access.writes[j]) == 0) {
+				return true;
+			}
+		}
+	}
+	for (unsigned int i = 0; i < a->access.num_reads; ++i) {
+		for (unsigned int j = 0; j < b->access.num_writes; ++j) {
+			if (strcmp(a->access.reads[i], b->access.writes[j]) == 0) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/*
+ * PURPOSE: Tells whether a command names a matrix that shares its data, or will
+ * 			once a view command of the batch has run. Names cannot show which
+ * 			commands touch the same elements then, so such a command is ordered
+ * 			against all the others.
+ * INPUTS:
+ * 		   batch : the batch
+ * 		   t : the command
+ * RETURN: True if the command must be a barrier
+ **/
+static bool touches_shared_data (const Batch_t* batch, const Task_t* t) {
+	const unsigned int n = t->access.num_reads + t->access.num_writes;
+	for (unsigned int i = 0; i < n; ++i) {
+		const char* name = i < t->access.num_reads ? t->access.reads[i]
+				: t->access.writes[i - t->access.num_reads];
+		if (workspace_shares_data(batch->mats, batch->num_mats, name)) {
+			return true;
+		}
+		for (unsigned int k = 0; k < batch->num_tasks; ++k) {
+			const Commands_t* v = batch->tasks[k].cmd;
+			if (strcmp(v->cmds[0], "view") == 0 && v->num_cmds == 7
+				&& (strcmp(v->cmds[1], name) == 0 || strcmp(v->cmds[2], name) == 0)) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/*
+ * PURPOSE: Works out which commands each command waits for
+ * INPUTS:
+ * 		   batch : the batch, with every task's command set
+ * RETURN: True if the graph was built. False if it could not be allocated.
+ **/
+static bool build_graph (Batch_t* batch) {
+	const unsigned int n = batch->num_tasks;
+	for (unsigned int i = 0; i < n; ++i) {
+		Task_t* t = &batch->tasks[i];
+		command_access(t->cmd, &t->access);
+		t->barrier = t->access.unknown || touches_shared_data(batch, t);
+	}
+	for (unsigned int i = 0; i < n; ++i) {
+		Task_t* t = &batch->tasks[i];
+		for (unsigned int j = i + 1; j < n; ++j) {
+			if (!depends(t, &batch->tasks[j])) {
+				continue;
+			}
+			if (!t->successors) {
+				t->successors = calloc(n - i - 1, sizeof(unsigned int));
+				if (!t->successors) {
+					fprintf(batch->out, "Failed to allocate command graph: %s\n", strerror(errno));
+					return false;
+				}
+			}
+			t->successors[t->num_successors++] = j;
+			batch->tasks[j].pending++;
+		}
+	}
+	return true;
+}
+
+static void push_task (Batch_t* batch, unsigned int worker, unsigned int task) {
+	Deque_t* d = &batch->deques[worker];
+	pthread_mutex_lock(&d->mutex);
+	d->tasks[d->bottom++] = task;
+	pthread_mutex_unlock(&d->mutex);
+
+	pthread_mutex_lock(&batch->idle_mutex);
+	batch->queued++;
+	pthread_cond_signal(&batch->idle_cond);
+	pthread_mutex_unlock(&batch->idle_mutex);
+}
+
+/*
+ * PURPOSE: Takes the next ready command, the newest of the worker's own or
+ * 			else the oldest of another worker's
+ * INPUTS:
+ * 		   batch : the batch
+ * 		   worker : the worker looking for a command
+ * RETURN: the command, or -1 if none is ready
+ **/
+static int take_task (Batch_t* batch, unsigned int worker) {
+	int task = -1;
+	for (unsigned int k = 0; k < batch->num_workers && task < 0; ++k) {
+		Deque_t* d = &batch->deques[(worker + k) % batch->num_workers];
+		pthread_mutex_lock(&d->mutex);
+		if (d->top < d->bottom) {
+			task = k == 0 ? d->tasks[--d->bottom] : d->tasks[d->top++];
+		}
+		pthread_mutex_unlock(&d->mutex);
+	}
+	if (task >= 0) {
+		pthread_mutex_lock(&batch->idle_mutex);
+		batch->queued--;
+		pthread_mutex_unlock(&batch->idle_mutex);
+	}
+	return task;
+}
+
+/*
+ * PURPOSE: Prints the output of every finished command that all earlier
+ * 			commands' output has already been printed before
+ * INPUTS:
+ * 		   batch : the batch
+ * RETURN: void
+ **/
+static void flush_output (Batch_t* batch) {
+	pthread_mutex_lock(&batch->flush_mutex);
+	while (batch->next_flush < batch->num_tasks
+		&& __atomic_load_n(&batch->tasks[batch->next_flush].done, __ATOMIC_ACQUIRE)) {
+		Task_t* t = &batch->tasks[batch->next_flush++];
+		if (t->output_error) {
+			fprintf(batch->out, "Output of %s could not be captured: %s\n", t->cmd->cmds[0],
+					strerror(t->output_error));
+		}
+		fwrite(t->output, 1, t->output_len, batch->out);
+		free(t->output);
+		t->output = NULL;
+	}
+	fflush(batch->out);
+	pthread_mutex_unlock(&batch->flush_mutex);
+}
+
+/*
+ * PURPOSE: Runs one command under the locks workspace_lock gives it, capturing
+ * 			its output, then makes ready the commands that waited only for it
+ * INPUTS:
+ * 		   batch : the batch
+ * 		   worker : the worker running the command
+ * 		   task : the command
+ * RETURN: void
+ **/
+static void run_task (Batch_t* batch, unsigned int worker, unsigned int task) {
+	Task_t* t = &batch->tasks[task];
+	FILE* out = open_memstream(&t->output, &t->output_len);
+	if (!out) {
+		t->output_error = errno;
+	}
+	Workspace_Lock_t hold;
+	workspace_lock(t->cmd, batch->mats, batch->num_mats, &hold);
+	run_commands(t->cmd, batch->mats, batch->num_mats, out ? out : stderr);
+	workspace_unlock(&hold);
+	if (out) {
+		fclose(out);
+	}
+	__atomic_store_n(&t->done, true, __ATOMIC_RELEASE);
+
+	for (unsigned int i = 0; i < t->num_successors; ++i) {
+		if (__atomic_sub_fetch(&batch->tasks[t->successors[i]].pending, 1, __ATOMIC_ACQ_REL) == 0) {
+			push_task(batch, worker, t->successors[i]);
+		}
+	}
+	flush_output(batch);
+
+	pthread_mutex_lock(&batch->idle_mutex);
+	if (--batch->remaining == 0) {
+		pthread_cond_broadcast(&batch->idle_cond);
+	}
+	pthread_mutex_unlock(&batch->idle_mutex);
+}
+
+/*
+ * PURPOSE: Worker thread, runs ready commands until every command has run
+ * INPUTS:
+ * 		   arg : the Worker_t
+ * RETURN: NULL
+ **/
+static void* worker_main (void* arg) {
+	Worker_t* w = arg;
+	Batch_t* batch = w->batch;
+	for (;;) {
+		int task = take_task(batch, w->worker);
+		if (task >= 0) {
+			run_task(batch, w->worker, task);
+			continue;
+		}
+		pthread_mutex_lock(&batch->idle_mutex);
+		while (batch->queued == 0 && batch->remaining > 0) {
+			pthread_cond_wait(&batch->idle_cond, &batch->idle_mutex);
+		}
+		bool finished = batch->remaining == 0;
+		pthread_mutex_unlock(&batch->idle_mutex);
+		if (finished) {
+			return NULL;
+		}
+	}
+}
+
+/*
+ * PURPOSE: Runs the commands of one line, independent ones at the same time,
+ * 			printing their output in the order they were given
+ * INPUTS:
+ * 		   cmds : the commands, from parse_command_line
+ * 		   num_cmds : number of commands
+ * 		   mats : list of matrices
+ * 		   num_mats : number of matrices in the list
+ * 		   out : stream the commands' output is printed to
+ * RETURN: void
+ **/
+void run_command_batch (Commands_t** cmds, unsigned int num_cmds, Matrix_t** mats,
+						unsigned int num_mats, FILE* out) {
+
+	if (!cmds || !mats || num_cmds == 0) {
+		return;
+	}
+	/* a lone command has nothing to overlap with */
+	if (num_cmds == 1) {
+		Workspace_Lock_t hold;
+		workspace_lock(cmds[0], mats, num_mats, &hold);
+		run_commands(cmds[0], mats, num_mats, out);
+		workspace_unlock(&hold);
+		return;
+	}
+
+	Batch_t batch;
+	memset(&batch, 0, sizeof(batch));
+	batch.num_tasks = num_cmds;
+	batch.mats = mats;
+	batch.num_mats = num_mats;
+	batch.out = out;
+	batch.remaining = num_cmds;
+	pthread_mutex_init(&batch.idle_mutex, NULL);
+	pthread_cond_init(&batch.idle_cond, NULL);
+	pthread_mutex_init(&batch.flush_mutex, NULL);
+
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	batch.num_workers = cpus < 1 ? 1 : (cpus < num_cmds ? cpus : num_cmds);
+	batch.tasks = calloc(num_cmds, sizeof(Task_t));
+	batch.deques = calloc(batch.num_workers, sizeof(Deque_t));
+	pthread_t* tids = calloc(batch.num_workers, sizeof(pthread_t));
+	Worker_t* workers = calloc(batch.num_workers, sizeof(Worker_t));
+	bool ok = batch.tasks && batch.deques && tids && workers;
+	for (unsigned int w = 0; ok && w < batch.num_workers; ++w) {
+		pthread_mutex_init(&batch.deques[w].mutex, NULL);
+		batch.deques[w].tasks = calloc(num_cmds, sizeof(unsigned int));
+		ok = batch.deques[w].tasks != NULL;
+	}
+	for (unsigned int i = 0; ok && i < num_cmds; ++i) {
+		batch.tasks[i].cmd = cmds[i];
+	}
+	ok = ok && build_graph(&batch);
+
+	if (!ok) {
+		/* fall back to running the commands one after another */
+		fprintf(out, "Failed to schedule commands, running them in order: %s\n", strerror(errno));
+		for (unsigned int i = 0; i < num_cmds; ++i) {
+			Workspace_Lock_t hold;
+			workspace_lock(cmds[i], mats, num_mats, &hold);
+			run_commands(cmds[i], mats, num_mats, out);
+			workspace_unlock(&hold);
+		}
+	}
+	else {
+		/* deal the commands that wait for nothing out to the workers, in order */
+		for (unsigned int i = 0, w = 0; i < num_cmds; ++i) {
+			if (batch.tasks[i].pending == 0) {
+				Deque_t* d = &batch.deques[w];
+				d->tasks[d->bottom++] = i;
+				batch.queued++;
+				w = (w + 1) % batch.num_workers;
+			}
+		}
+		/* owners pop the newest, so turn each deque round to start with its oldest */
+		for (unsigned int w = 0; w < batch.num_workers; ++w) {
+			Deque_t* d = &batch.deques[w];
+			for (unsigned int i = 0; i < d->bottom / 2; ++i) {
+				unsigned int tmp = d->tasks[i];
+				d->tasks[i] = d->tasks[d->bottom - 1 - i];
+				d->tasks[d->bottom - 1 - i] = tmp;
+			}
+		}
+
+		unsigned int started = 1;
+		for (; started < batch.num_workers; ++started) {
+			workers[started].batch = &batch;
+			workers[started].worker = started;
+			if (pthread_create(&tids[started], NULL, worker_main, &workers[started])) {
+				/* the workers already started, and this thread, steal its share */
+				break;
+			}
+		}
+		workers[0].batch = &batch;
+		workers[0].worker = 0;
+		worker_main(&workers[0]);
+		for (unsigned int w = 1; w < started; ++w) {
+			pthread_join(tids[w], NULL);
+		}
+		flush_output(&batch);
+	}
+
+	for (unsigned int i = 0; batch.tasks && i < num_cmds; ++i) {
+		free(batch.tasks[i].successors);
+		free(batch.tasks[i].output);
+	}
+	for (unsigned int w = 0; batch.deques && w < batch.num_workers; ++w) {
+		pthread_mutex_destroy(&batch.deques[w].mutex);
+		free(batch.deques[w].tasks);
+	}
+	pthread_mutex_destroy(&batch.idle_mutex);
+	pthread_cond_destroy(&batch.idle_cond);
+	pthread_mutex_destroy(&batch.flush_mutex);
+	free(batch.tasks);
+	free(batch.deques);
+	free(tids);
+	free(workers);
+}
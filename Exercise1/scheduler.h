@@ -0,0 +1,14 @@
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+/*
+ * Runs the commands of one line, as split by parse_command_line. A command
+ * waits for every earlier command that uses a matrix it uses, when either
+ * of them changes it. Commands that do not depend on each other run at the
+ * same time on a pool of workers. Output is printed in the order the
+ * commands were given.
+ */
+void run_command_batch (Commands_t** cmds, unsigned int num_cmds, Matrix_t** mats,
+						unsigned int num_mats, FILE* out);
+
+#endif
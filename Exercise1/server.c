@@ -0,0 +1,453 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "command.h"
+#include "matrix.h"
+#include "protocol.h"
+#include "scheduler.h"
+#include "server.h"
+
+#define MAX_EVENTS 64
+#define MIN_WORKERS 4
+
+void run_commands (Commands_t* cmd, Matrix_t** mats, unsigned int num_mats, FILE* out);
+
+/*
+ * One client. The event loop appends what the client sends to in. While
+ * busy a worker owns the connection and is running its requests one at a
+ * time, so replies go back in the order they were asked for.
+ */
+typedef struct Connection {
+	int fd;
+	pthread_mutex_t mutex;
+	char in[MAX_REQUEST_LEN];
+	size_t in_len;
+	bool busy;
+	bool closed;
+	struct Connection* next_ready;
+	struct Connection* prev;
+	struct Connection* next;
+}Connection_t;
+
+typedef struct {
+	Matrix_t** mats;
+	unsigned int num_mats;
+}Server_t;
+
+/* connections with a request waiting for a worker, oldest first */
+static pthread_mutex_t ready_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ready_cond = PTHREAD_COND_INITIALIZER;
+static Connection_t* ready_head = NULL;
+static Connection_t* ready_tail = NULL;
+static bool stopping = false;
+
+/* every open connection, so they can be freed on shutdown */
+static pthread_mutex_t conns_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Connection_t* conns = NULL;
+
+static volatile sig_atomic_t serving = 1;
+
+static void stop_serving (int sig) {
+	serving = 0;
+}
+
+/* 
+ * PURPOSE: Queues a connection for the next free worker
+ * INPUTS: 
+ * 		   c : connection with a complete request in its buffer
+ * RETURN: void
+ **/
+static void push_ready (Connection_t* c) {
+	pthread_mutex_lock(&ready_mutex);
+	c->next_ready = NULL;
+	if (ready_tail) {
+		ready_tail->next_ready = c;
+	}
+	else {
+		ready_head = c;
+	}
+	ready_tail = c;
+	pthread_cond_signal(&ready_cond);
+	pthread_mutex_unlock(&ready_mutex);
+}
+
+/* 
+ * PURPOSE: Waits for a queued connection
+ * INPUTS: none
+ * RETURN: the oldest queued connection, or NULL once the server is stopping
+ **/
+static Connection_t* pop_ready (void) {
+	pthread_mutex_lock(&ready_mutex);
+	while (!ready_head && !stopping) {
+		pthread_cond_wait(&ready_cond, &ready_mutex);
+	}
+	Connection_t* c = ready_head;
+	if (c) {
+		ready_head = c->next_ready;
+		if (!ready_head) {
+			ready_tail = NULL;
+		}
+	}
+	pthread_mutex_unlock(&ready_mutex);
+	return c;
+}
+
+static Connection_t* new_connection (int fd) {
+	Connection_t* c = calloc(1, sizeof(Connection_t));
+	if (!c) {
+		return NULL;
+	}
+	c->fd = fd;
+	pthread_mutex_init(&c->mutex, NULL);
+	pthread_mutex_lock(&conns_mutex);
+	c->next = conns;
+	if (conns) {
+		conns->prev = c;
+	}
+	conns = c;
+	pthread_mutex_unlock(&conns_mutex);
+	return c;
+}
+
+static void free_connection (Connection_t* c) {
+	pthread_mutex_lock(&conns_mutex);
+	if (c->prev) {
+		c->prev->next = c->next;
+	}
+	else {
+		conns = c->next;
+	}
+	if (c->next) {
+		c->next->prev = c->prev;
+	}
+	pthread_mutex_unlock(&conns_mutex);
+	close(c->fd);
+	pthread_mutex_destroy(&c->mutex);
+	free(c);
+}
+
+/* 
+ * PURPOSE: Moves the first complete request line out of a connection's buffer.
+ * 			Must be called with the connection's mutex held.
+ * INPUTS: 
+ * 		   c : connection
+ * 		   line : receives the request without its '\n'
+ * RETURN: True if a request was taken. False if no complete line is buffered.
+ **/
+static bool take_line (Connection_t* c, char line[MAX_REQUEST_LEN]) {
+	char* nl = memchr(c->in, '\n', c->in_len);
+	if (!nl) {
+		return false;
+	}
+	size_t len = nl - c->in;
+	memcpy(line, c->in, len);
+	line[len] = '\0';
+	c->in_len -= len + 1;
+	memmove(c->in, nl + 1, c->in_len);
+	return true;
+}
+
+/* 
+ * PURPOSE: Runs one request line and sends its output back to the client. Each
+ * 			command holds only the locks workspace_lock gives it, so commands
+ * 			reading the same matrix run side by side.
+ * INPUTS: 
+ * 		   server : matrices being served
+ * 		   c : connection the request came from
+ * 		   line : the request
+ * RETURN: void
+ **/
+static void handle_request (Server_t* server, Connection_t* c, const char* line) {
+	char* reply = NULL;
+	size_t reply_len = 0;
+	FILE* out = open_memstream(&reply, &reply_len);
+	if (!out) {
+		perror("Failed to allocate reply\n");
+		shutdown(c->fd, SHUT_RDWR);
+		return;
+	}
+
+	Commands_t** cmds = NULL;
+	unsigned int num_cmds = 0;
+	if (!parse_command_line(line, &cmds, &num_cmds)) {
+		fprintf(out, "\nERROR:Failed at parsing command\n");
+	}
+	else if (num_cmds == 1 && cmds[0]->num_cmds == 1 && strcmp(cmds[0]->cmds[0], "exit") == 0) {
+		shutdown(c->fd, SHUT_RDWR);
+	}
+	else if (num_cmds > 0) {
+		run_command_batch(cmds, num_cmds, server->mats, server->num_mats, out);
+	}
+	destroy_command_line(&cmds, num_cmds);
+
+	fputc(RESPONSE_END, out);
+	fclose(out);
+	send_all(c->fd, reply, reply_len);
+	free(reply);
+}
+
+/* 
+ * PURPOSE: Worker thread. Takes one request at a time from a queued connection
+ * 			and requeues the connection behind the others if it has more, so a
+ * 			client sending a burst of requests cannot starve the rest.
+ * INPUTS: 
+ * 		   arg : the Server_t being served
+ * RETURN: NULL
+ **/
+static void* worker_main (void* arg) {
+	Server_t* server = arg;
+	char line[MAX_REQUEST_LEN];
+	Connection_t* c;
+	while ((c = pop_ready())) {
+		pthread_mutex_lock(&c->mutex);
+		bool have = take_line(c, line);
+		pthread_mutex_unlock(&c->mutex);
+
+		if (have) {
+			handle_request(server, c, line);
+		}
+
+		pthread_mutex_lock(&c->mutex);
+		bool more = !c->closed && memchr(c->in, '\n', c->in_len);
+		c->busy = more;
+		bool release = c->closed;
+		pthread_mutex_unlock(&c->mutex);
+		if (more) {
+			push_ready(c);
+		}
+		else if (release) {
+			free_connection(c);
+		}
+	}
+	return NULL;
+}
+
+/* 
+ * PURPOSE: Drains everything a client has sent into its buffer and hands the
+ * 			connection to a worker if a request is complete and none is running.
+ * INPUTS: 
+ * 		   epfd : epoll instance watching the connection
+ * 		   c : readable connection
+ * RETURN: void
+ **/
+static void read_connection (int epfd, Connection_t* c) {
+	char buf[MAX_REQUEST_LEN];
+	bool eof = false;
+	for (;;) {
+		ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			break;
+		}
+		if (n <= 0) {
+			eof = true;
+			break;
+		}
+		pthread_mutex_lock(&c->mutex);
+		if (c->in_len + n > sizeof(c->in)) {
+			/* a request longer than MAX_REQUEST_LEN, drop the client */
+			eof = true;
+		}
+		else {
+			memcpy(&c->in[c->in_len], buf, n);
+			c->in_len += n;
+		}
+		pthread_mutex_unlock(&c->mutex);
+		if (eof) {
+			break;
+		}
+	}
+
+	pthread_mutex_lock(&c->mutex);
+	bool dispatch = !eof && !c->busy && memchr(c->in, '\n', c->in_len);
+	bool release = false;
+	if (dispatch) {
+		c->busy = true;
+	}
+	if (eof) {
+		epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+		c->closed = true;
+		release = !c->busy;
+	}
+	pthread_mutex_unlock(&c->mutex);
+
+	if (dispatch) {
+		push_ready(c);
+	}
+	else if (release) {
+		free_connection(c);
+	}
+}
+
+/* 
+ * PURPOSE: Accepts every pending client and registers it with epoll
+ * INPUTS: 
+ * 		   epfd : epoll instance
+ * 		   listen_fd : listening socket
+ * RETURN: void
+ **/
+static void accept_connections (int epfd, int listen_fd) {
+	for (;;) {
+		int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				perror("FAILED TO ACCEPT CLIENT\n");
+			}
+			return;
+		}
+		Connection_t* c = new_connection(fd);
+		if (!c) {
+			perror("Failed to allocate connection\n");
+			close(fd);
+			continue;
+		}
+		struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = c };
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+			perror("FAILED TO WATCH CLIENT\n");
+			free_connection(c);
+		}
+	}
+}
+
+/* 
+ * PURPOSE: Creates the listening unix socket, replacing a stale socket file
+ * INPUTS: 
+ * 		   socket_path : filesystem path to listen on
+ * RETURN: listening non blocking socket, or -1 on failure
+ **/
+static int listen_on (const char* socket_path) {
+	struct sockaddr_un addr;
+	if (strlen(socket_path) + 1 > sizeof(addr.sun_path)) {
+		printf("\nSocket path %s is too long\n", socket_path);
+		return -1;
+	}
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		perror("FAILED TO CREATE SOCKET\n");
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socket_path);
+	unlink(socket_path);
+	if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+		perror("FAILED TO LISTEN ON SOCKET\n");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* 
+ * PURPOSE: Serves the matrix array to any number of local clients until SIGINT
+ * 			or SIGTERM. One thread runs an epoll loop that accepts clients and
+ * 			reads their requests, a pool of workers runs the commands.
+ * INPUTS: 
+ * 		   socket_path : filesystem path of the unix socket to listen on
+ * 		   mats : list of matrices shared by every client
+ * 		   num_mats : number of matrices in the list
+ * RETURN: True after a clean shutdown. False if the server could not start.
+ **/
+bool serve (const char* socket_path, Matrix_t** mats, unsigned int num_mats) {
+
+	if (!socket_path || !mats) {
+		printf("\nSocket path or matrix array is null\n");
+		return false;
+	}
+
+	int listen_fd = listen_on(socket_path);
+	if (listen_fd < 0) {
+		return false;
+	}
+	int epfd = epoll_create1(EPOLL_CLOEXEC);
+	struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+	if (epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
+		perror("FAILED TO CREATE EPOLL INSTANCE\n");
+		close(listen_fd);
+		if (epfd >= 0) {
+			close(epfd);
+		}
+		unlink(socket_path);
+		return false;
+	}
+
+	/* signals are only taken while waiting in epoll, never by a worker */
+	sigset_t stop_signals, wait_mask;
+	sigemptyset(&stop_signals);
+	sigaddset(&stop_signals, SIGINT);
+	sigaddset(&stop_signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &stop_signals, &wait_mask);
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = stop_serving;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	Server_t server = { .mats = mats, .num_mats = num_mats };
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int num_workers = cpus > MIN_WORKERS ? cpus : MIN_WORKERS;
+	pthread_t workers[num_workers];
+	unsigned int started = 0;
+	for (; started < num_workers; ++started) {
+		if (pthread_create(&workers[started], NULL, worker_main, &server)) {
+			perror("Failed to start worker thread\n");
+			break;
+		}
+	}
+
+	printf("Serving on %s with %u workers\n", socket_path, started);
+	fflush(stdout);
+
+	struct epoll_event events[MAX_EVENTS];
+	while (serving && started > 0) {
+		int n = epoll_pwait(epfd, events, MAX_EVENTS, -1, &wait_mask);
+		if (n < 0) {
+			if (errno != EINTR) {
+				perror("EPOLL WAIT FAILED\n");
+				break;
+			}
+			continue;
+		}
+		for (int i = 0; i < n; ++i) {
+			if (!events[i].data.ptr) {
+				accept_connections(epfd, listen_fd);
+			}
+			else {
+				read_connection(epfd, events[i].data.ptr);
+			}
+		}
+	}
+
+	pthread_mutex_lock(&ready_mutex);
+	stopping = true;
+	pthread_cond_broadcast(&ready_cond);
+	pthread_mutex_unlock(&ready_mutex);
+	for (unsigned int i = 0; i < started; ++i) {
+		pthread_join(workers[i], NULL);
+	}
+	while (conns) {
+		free_connection(conns);
+	}
+	ready_head = ready_tail = NULL;
+
+	close(epfd);
+	close(listen_fd);
+	unlink(socket_path);
+	pthread_sigmask(SIG_SETMASK, &wait_mask, NULL);
+	printf("\nServer on %s stopped\n", socket_path);
+	return started > 0;
+}
@@ -0,0 +1,6 @@
+#ifndef _SERVER_H_
+#define _SERVER_H_
+
+bool serve (const char* socket_path, Matrix_t** mats, unsigned int num_mats);
+
+#endif
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "command.h"
+#include "matrix.h"
+#include "workspace.h"
+
+/* Guards which matrices are in the array */
+static pthread_rwlock_t array_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/* The hold of the command running on this thread, for workspace_register */
+static __thread Workspace_Lock_t* thread_hold;
+
+/* 
+ * PURPOSE: Looks a matrix up by name without reloading it if it was spilled or
+ * 			changing its least recently used position
+ * INPUTS: 
+ * 		   mats : list of matrices
+ * 		   num_mats : number of matrices in the list
+ * 		   name : matrix name
+ * RETURN: slot of the matrix, or -1 if it is not in memory
+ **/
+static int find_resident (Matrix_t** mats, unsigned int num_mats, const char* name) {
+	for (unsigned int i = 0; i < num_mats; ++i) {
+		if (mats[i] && strncmp(mats[i]->name, name, MATRIX_NAME_LEN) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/* 
+ * PURPOSE: Blocks until cmd may safely run alongside commands on other threads.
+ * 			Matrices are always locked in array order so two commands naming
+ * 			the same matrices cannot deadlock.
+ * INPUTS: 
+ * 		   cmd : command about to run
+ * 		   mats : list of matrices
+ * 		   num_mats : number of matrices in the list
+ * 		   hold : filled with the locks taken, pass to workspace_unlock
+ * RETURN: void
+ **/
+void workspace_lock (Commands_t* cmd, Matrix_t** mats, unsigned int num_mats, Workspace_Lock_t* hold) {
+
+	Command_Access_t access;
+	memset(hold, 0, sizeof(Workspace_Lock_t));
+	thread_hold = hold;
+	if (!command_access(cmd, &access) || access.unknown) {
+		pthread_rwlock_wrlock(&array_lock);
+		hold->exclusive = true;
+		return;
+	}
+
+	pthread_rwlock_rdlock(&array_lock);
+
+	/*
+	 * mark each slot that is named, writes win over reads of the same matrix.
+	 * A name that is not in the array may be spilled, and bringing it back
+	 * changes the array, so the command must then hold it exclusively, as
+	 * it must when a named matrix is a view or has views. The result of a
+	 * registering command needs no lock while it is not yet in the array.
+	 */
+	char mode[num_mats];
+	memset(mode, 0, num_mats);
+	bool all_resident = true;
+	bool shares_data = false;
+	for (unsigned int i = 0; i < access.num_reads + access.num_writes; ++i) {
+		const bool write = i >= access.num_reads;
+		int idx = find_resident(mats, num_mats,
+				write ? access.writes[i - access.num_reads] : access.reads[i]);
+		if (idx < 0) {
+			all_resident = all_resident && write && access.registers
+					&& !is_spilled_matrix(access.writes[i - access.num_reads]);
+		}
+		else if (mats[idx]->parent || mats[idx]->views) {
+			/* a view and its parent are locked separately but share data */
+			shares_data = true;
+		}
+		else if (write || !mode[idx]) {
+			mode[idx] = write ? 'w' : 'r';
+		}
+	}
+	if (!all_resident || shares_data) {
+		pthread_rwlock_unlock(&array_lock);
+		pthread_rwlock_wrlock(&array_lock);
+		hold->exclusive = true;
+		return;
+	}
+
+	for (unsigned int i = 0; i < num_mats; ++i) {
+		if (mode[i] == 'r') {
+			pthread_rwlock_rdlock(&mats[i]->lock);
+		}
+		else if (mode[i] == 'w') {
+			pthread_rwlock_wrlock(&mats[i]->lock);
+		}
+		else {
+			continue;
+		}
+		hold->locked[hold->num_locked++] = mats[i];
+	}
+}
+
+/* 
+ * PURPOSE: Releases every lock taken by workspace_lock
+ * INPUTS: 
+ * 		   hold : locks returned by workspace_lock
+ * RETURN: void
+ **/
+void workspace_unlock (Workspace_Lock_t* hold) {
+
+	for (unsigned int i = hold->num_locked; i > 0; --i) {
+		pthread_rwlock_unlock(&hold->locked[i - 1]->lock);
+	}
+	hold->num_locked = 0;
+	pthread_rwlock_unlock(&array_lock);
+	hold->exclusive = false;
+	thread_hold = NULL;
+}
+
+/* 
+ * PURPOSE: Adds a matrix computed by the command running on this thread to the
+ * 			array. The command's matrix locks are released and the array taken
+ * 			exclusively, since the matrix may replace or spill any other. The
+ * 			command must not use the matrices it looked up after this.
+ * INPUTS: 
+ * 		   out : stream diagnostics are printed to
+ * 		   mats : list of matrices
+ * 		   m : matrix to add
+ * 		   num_mats : number of matrices in the list
+ * RETURN: as add_matrix_to_array
+ **/
+unsigned int workspace_register (FILE* out, Matrix_t** mats, Matrix_t* m, unsigned int num_mats) {
+
+	Workspace_Lock_t* hold = thread_hold;
+	if (hold && !hold->exclusive) {
+		/* matrix locks go first, a thread waiting on one holds the array shared */
+		for (unsigned int i = hold->num_locked; i > 0; --i) {
+			pthread_rwlock_unlock(&hold->locked[i - 1]->lock);
+		}
+		hold->num_locked = 0;
+		pthread_rwlock_unlock(&array_lock);
+		pthread_rwlock_wrlock(&array_lock);
+		hold->exclusive = true;
+	}
+	return add_matrix_to_array(out, mats, m, num_mats);
+}
+
+/* 
+ * PURPOSE: Tells whether a matrix in memory shares its data with another, being
+ * 			a view or having views, so that commands naming it and commands
+ * 			naming the other may not be reordered
+ * INPUTS: 
+ * 		   mats : list of matrices
+ * 		   num_mats : number of matrices in the list
+ * 		   name : matrix name
+ * RETURN: True if the matrix is in memory and shares its data
+ **/
+bool workspace_shares_data (Matrix_t** mats, unsigned int num_mats, const char* name) {
+
+	pthread_rwlock_rdlock(&array_lock);
+	int idx = find_resident(mats, num_mats, name);
+	bool shares = idx >= 0 && (mats[idx]->parent || mats[idx]->views);
+	pthread_rwlock_unlock(&array_lock);
+	return shares;
+}
@@ -0,0 +1,22 @@
+#ifndef _WORKSPACE_H_
+#define _WORKSPACE_H_
+
+/*
+ * A hold on the matrix array taken before running a command from one of
+ * several threads. A command shares the array and holds a read or write
+ * lock on just the matrices it names. A command that registers a matrix
+ * computes it under those locks, then holds the whole array exclusively
+ * only while workspace_register adds it.
+ */
+typedef struct {
+	bool exclusive;
+	unsigned int num_locked;
+	Matrix_t* locked[2 * MAX_CMD_ACCESS];
+}Workspace_Lock_t;
+
+void workspace_lock (Commands_t* cmd, Matrix_t** mats, unsigned int num_mats, Workspace_Lock_t* hold);
+void workspace_unlock (Workspace_Lock_t* hold);
+unsigned int workspace_register (FILE* out, Matrix_t** mats, Matrix_t* m, unsigned int num_mats);
+bool workspace_shares_data (Matrix_t** mats, unsigned int num_mats, const char* name);
+
+#endif